@@ -0,0 +1,550 @@
+/**
+ * @file aot.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "aot.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <set>
+#include <sstream>
+
+#if HYS_AOT
+#include <cerrno>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// int hys_run(uint64_t frames, var* value, const char** err)
+using Entry = int (*)(uint64_t, var*, const char**);
+
+const char* const entryName = "hys_run";
+
+// prelude of every generated source
+const char* const prelude = R"(#include <cstdint>
+
+typedef int64_t var;
+
+namespace {
+
+struct Exit {
+	var code;
+};
+
+struct Halt {
+};
+
+struct Error {
+	const char* msg;
+};
+
+uint64_t depth = 0;
+uint64_t limit = 0;
+
+// add, sub and mul wrap on signed overflow as the interpreter does
+inline var WrapAdd(var left, var right) {
+	return static_cast<var>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+}
+
+inline var WrapSub(var left, var right) {
+	return static_cast<var>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right));
+}
+
+inline var WrapMul(var left, var right) {
+	return static_cast<var>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+}
+
+// a call takes a frame of control stack as interpreter does
+struct Frame {
+	Frame() {
+		if (++depth > limit) {
+			throw Error{ "Call: stack overflow." };
+		}
+	}
+	~Frame() {
+		--depth;
+	}
+};
+
+)";
+
+// args of running the entry on a thread with a stack for deep calls
+struct Call {
+	Entry entry;
+	uint64_t frames;
+	var value;
+	const char* err;
+	int status;
+};
+
+std::string Imm(var value) {
+	if (value == std::numeric_limits<var>::min()) {
+		return "(-9223372036854775807LL - 1)";
+	}
+	return std::to_string(value) + "LL";
+}
+
+std::string R(uint32_t reg) {
+	return "r" + std::to_string(reg);
+}
+
+std::string FuncName(const RegProgram& program, uint32_t funcIdx) {
+	return "f" + std::to_string(funcIdx) + (funcIdx == 0 ? "" : "_" + program.funcs[funcIdx].name);
+}
+
+// FNV-1a, the cache key of shared object
+uint64_t Hash(const std::string& str) {
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : str) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+const char* BinaryStr(RegOp op) {
+	static const char* const strs[] = {
+		"+", "-", "*", "/", "%", "&&", "||", "&", "|", "^", "==", "!=", ">", "<", ">=", "<="
+	};
+	size_t i = op >= RegOp::ADDI && op <= RegOp::CMPLEI ?
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::ADDI) :
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::ADD);
+	return strs[i];
+}
+
+// add, sub and mul call the wrapping helpers of prelude, nullptr for the others
+const char* WrapStr(RegOp op) {
+	static const char* const strs[] = { "WrapAdd", "WrapSub", "WrapMul" };
+	size_t i = op >= RegOp::ADDI && op <= RegOp::CMPLEI ?
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::ADDI) :
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::ADD);
+	return i < sizeof(strs) / sizeof(strs[0]) ? strs[i] : nullptr;
+}
+
+const char* BranchStr(RegOp op) {
+	static const char* const strs[] = { "==", "!=", ">", "<", ">=", "<=" };
+	size_t i = op >= RegOp::BREQI ?
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::BREQI) :
+		static_cast<size_t>(op) - static_cast<size_t>(RegOp::BREQ);
+	return strs[i];
+}
+
+#if HYS_AOT
+void* RunCall(void* arg) {
+	auto* call = static_cast<Call*>(arg);
+	call->status = call->entry(call->frames, &call->value, &call->err);
+	return nullptr;
+}
+#endif
+
+} // namespace
+
+Aot::~Aot() {
+	Release();
+}
+
+void Aot::Release() {
+#if HYS_AOT
+	if (handle_ != nullptr) {
+		dlclose(handle_);
+	}
+#endif
+	handle_ = nullptr;
+	entry_ = nullptr;
+}
+
+bool Aot::Generate(const Program& program, std::string& source) {
+	if (!regVm_.Translate(program)) {
+		return false;
+	}
+	const auto& reg = regVm_.GetProgram();
+	const auto& code = reg.code;
+	uint64_t halt = code.size() - 1;
+	std::ostringstream out;
+	out << prelude;
+
+	for (uint32_t f = 1; f < reg.funcs.size(); f++) {
+		out << "var " << FuncName(reg, f) << "(";
+		for (uint32_t i = 0; i < reg.funcs[f].argc; i++) {
+			out << (i == 0 ? "" : ", ") << "var";
+		}
+		out << ");\n";
+	}
+	out << "\n";
+
+	// a tail call of another function returns to a trampoline after the call which made the chain,
+	// which calls the next function, so a chain of mutual tail calls keeps one native frame
+	std::set<uint32_t> bounced;
+	uint32_t bounceArgc = 1;
+	for (uint32_t f = 0; f < reg.funcs.size(); f++) {
+		uint64_t end = f + 1 < reg.funcs.size() ? reg.funcs[f + 1].entry : halt;
+		for (uint64_t ip = reg.funcs[f].entry; ip < end; ip++) {
+			if (code[ip].op == RegOp::TAILCALL && code[ip].b != f) {
+				bounced.insert(code[ip].b);
+				bounceArgc = std::max(bounceArgc, reg.funcs[code[ip].b].argc);
+			}
+		}
+	}
+	if (!bounced.empty()) {
+		out << "// the function called next by the trampoline, 0 if none\n"
+			"uint32_t bounceFunc = 0;\n"
+			"var bounceArgs[" << bounceArgc << "];\n\n"
+			"var Bounce();\n\n";
+	}
+	auto bounce = [&](const std::string& value) {
+		return bounced.empty() ? std::string() : " while (bounceFunc != 0) " + value + " = Bounce();";
+	};
+
+	for (uint32_t f = 0; f < reg.funcs.size(); f++) {
+		const auto& func = reg.funcs[f];
+		uint64_t end = f + 1 < reg.funcs.size() ? reg.funcs[f + 1].entry : halt;
+
+		// args are parameters, the other registers are zeroed locals
+		out << "var " << FuncName(reg, f) << "(";
+		for (uint32_t i = 0; i < func.argc; i++) {
+			out << (i == 0 ? "" : ", ") << "var " << R(i);
+		}
+		out << ") {\n";
+		if (f > 0) {
+			out << "\tFrame frame;\n";
+		}
+		for (uint32_t i = func.argc; i < func.size; i++) {
+			out << "\tvar " << R(i) << " = 0;\n";
+		}
+		out << "entry:;\n";
+
+		std::set<uint64_t> targets;
+		for (uint64_t ip = func.entry; ip < end; ip++) {
+			const auto& rc = code[ip];
+			if (rc.op == RegOp::JMP || rc.op == RegOp::JZ || (rc.op >= RegOp::BREQ && rc.op <= RegOp::BRLEI)) {
+				targets.insert(rc.dst);
+			}
+		}
+		// halt may be reached from any function
+		auto jump = [&](uint32_t target) {
+			return target == halt ? std::string("throw Halt{};") : "goto L" + std::to_string(target) + ";";
+		};
+
+		for (uint64_t ip = func.entry; ip < end; ip++) {
+			const auto& rc = code[ip];
+			if (targets.count(ip) > 0) {
+				auto it = reg.labels.find(ip);
+				out << "L" << ip << ":;" << (it == reg.labels.end() ? "" : " // " + it->second) << "\n";
+			}
+			out << "\t";
+			switch (rc.op) {
+			case RegOp::DIV:
+			case RegOp::MOD:
+				out << "if (" << R(rc.b) << " == 0) throw Error{ \"" <<
+					(rc.op == RegOp::DIV ? "Div" : "Mod") << ": divided by zero.\" }; ";
+				out << "if (" << R(rc.b) << " == -1 && " << R(rc.a) << " == " << Imm(std::numeric_limits<var>::min()) <<
+					") throw Error{ \"" << (rc.op == RegOp::DIV ? "Div" : "Mod") << ": overflow.\" }; ";
+				out << R(rc.dst) << " = " << R(rc.a) << " " << BinaryStr(rc.op) << " " << R(rc.b) << ";";
+				break;
+			case RegOp::NEG:
+				out << R(rc.dst) << " = WrapSub(0, " << R(rc.a) << ");";
+				break;
+			case RegOp::NOT:
+				out << R(rc.dst) << " = !" << R(rc.a) << ";";
+				break;
+			case RegOp::SHLI:
+				out << R(rc.dst) << " = static_cast<var>(static_cast<uint64_t>(" << R(rc.a) << ") << " << rc.imm << ");";
+				break;
+			case RegOp::SHRI:
+			case RegOp::MASKI:
+				// the compiler divides by the power of two with shifts
+				out << R(rc.dst) << " = " << R(rc.a) << (rc.op == RegOp::SHRI ? " / " : " % ") << Imm(1LL << rc.imm) << ";";
+				break;
+			case RegOp::MOV:
+				out << R(rc.dst) << " = " << R(rc.a) << ";";
+				break;
+			case RegOp::MOVI:
+				out << R(rc.dst) << " = " << Imm(rc.imm) << ";";
+				break;
+			case RegOp::JMP:
+				out << jump(rc.dst);
+				break;
+			case RegOp::JZ:
+				out << "if (" << R(rc.a) << " == 0) " << jump(rc.dst);
+				break;
+			case RegOp::CALL: {
+				const auto& callee = reg.funcs[rc.b];
+				out << R(rc.a) << " = " << FuncName(reg, rc.b) << "(";
+				for (uint32_t i = 0; i < callee.argc; i++) {
+					out << (i == 0 ? "" : ", ") << R(rc.a + i);
+				}
+				out << ");" << bounce(R(rc.a));
+				break;
+			}
+			case RegOp::TAILCALL: {
+				const auto& callee = reg.funcs[rc.b];
+				if (rc.b == f) {
+					// a tail recursion is a loop, args are in temps above the slots
+					for (uint32_t i = 0; i < callee.argc; i++) {
+						out << R(i) << " = " << R(rc.a + i) << "; ";
+					}
+					for (uint32_t i = callee.argc; i < callee.argc + callee.varc; i++) {
+						out << R(i) << " = 0; ";
+					}
+					out << "goto entry;";
+					break;
+				}
+				// the frame is left before the trampoline calls callee, as the interpreter reuses it
+				for (uint32_t i = 0; i < callee.argc; i++) {
+					out << "bounceArgs[" << i << "] = " << R(rc.a + i) << "; ";
+				}
+				out << "bounceFunc = " << rc.b << "; return 0;";
+				break;
+			}
+			case RegOp::RET:
+				out << "return " << R(rc.a) << ";";
+				break;
+			case RegOp::RETI:
+				out << "return " << Imm(rc.imm) << ";";
+				break;
+			case RegOp::RETV:
+				out << "return 0;";
+				break;
+			case RegOp::EXIT:
+				out << "throw Exit{ " << R(rc.a) << " };";
+				break;
+			case RegOp::EXITI:
+				out << "throw Exit{ " << Imm(rc.imm) << " };";
+				break;
+			case RegOp::EXITV:
+				out << "throw Exit{ 0 };";
+				break;
+			case RegOp::HALT:
+				out << "throw Halt{};";
+				break;
+			default:
+				if (rc.op >= RegOp::BREQ && rc.op <= RegOp::BRLE) {
+					out << "if (!(" << R(rc.a) << " " << BranchStr(rc.op) << " " << R(rc.b) << ")) " << jump(rc.dst);
+				} else if (rc.op >= RegOp::BREQI && rc.op <= RegOp::BRLEI) {
+					out << "if (!(" << R(rc.a) << " " << BranchStr(rc.op) << " " << Imm(rc.imm) << ")) " << jump(rc.dst);
+				} else if ((rc.op >= RegOp::ADD && rc.op <= RegOp::CMPLE) ||
+					(rc.op >= RegOp::ADDI && rc.op <= RegOp::CMPLEI)) {
+					std::string right = rc.op >= RegOp::ADDI ? Imm(rc.imm) : R(rc.b);
+					const char* wrap = WrapStr(rc.op);
+					out << R(rc.dst) << " = ";
+					if (wrap != nullptr) {
+						out << wrap << "(" << R(rc.a) << ", " << right << ");";
+					} else {
+						out << R(rc.a) << " " << BinaryStr(rc.op) << " " << right << ";";
+					}
+				} else {
+					std::cerr << "[warn]: AOT does not support instruction " << ip << "." << std::endl;
+					return false;
+				}
+				break;
+			}
+			out << "\n";
+		}
+		// register code never falls off a function
+		out << "\tthrow Halt{};\n}\n\n";
+	}
+
+	if (!bounced.empty()) {
+		out << "var Bounce() {\n"
+			"\tuint32_t callee = bounceFunc;\n"
+			"\tbounceFunc = 0;\n"
+			"\tswitch (callee) {\n";
+		for (uint32_t f : bounced) {
+			out << "\tcase " << f << ":\n\t\treturn " << FuncName(reg, f) << "(";
+			for (uint32_t i = 0; i < reg.funcs[f].argc; i++) {
+				out << (i == 0 ? "" : ", ") << "bounceArgs[" << i << "]";
+			}
+			out << ");\n";
+		}
+		out << "\t}\n\treturn 0;\n}\n\n";
+	}
+
+	out << "} // namespace\n\n"
+		"extern \"C\" int " << entryName << "(uint64_t frames, var* value, const char** err) {\n"
+		"\tdepth = 0;\n"
+		"\tlimit = frames;\n"
+		<< (bounced.empty() ? "" : "\tbounceFunc = 0;\n") <<
+		"\ttry {\n"
+		"\t\t*value = f0();" << bounce("*value") << "\n"
+		"\t\treturn " << OK << ";\n"
+		"\t} catch (const Exit& e) {\n"
+		"\t\t*value = e.code;\n"
+		"\t\treturn " << EXIT << ";\n"
+		"\t} catch (const Halt&) {\n"
+		"\t\treturn " << HALT << ";\n"
+		"\t} catch (const Error& e) {\n"
+		"\t\t*err = e.msg;\n"
+		"\t\treturn " << ERROR << ";\n"
+		"\t}\n"
+		"}\n";
+	source = out.str();
+	return true;
+}
+
+#if HYS_AOT
+namespace {
+
+// the cache is private to the user, else another user could put an object in it to be loaded
+bool MakePrivateDir(const std::string& dir) {
+	if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+		return false;
+	}
+	struct stat st;
+	return lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == geteuid() &&
+		(st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// $XDG_CACHE_HOME/hysim, ~/.cache/hysim, or $TMPDIR/hysim-uid without a home
+bool CacheDir(std::string& dir) {
+	const char* cache = std::getenv("XDG_CACHE_HOME");
+	const char* home = std::getenv("HOME");
+	if ((cache != nullptr && *cache == '/') || (home != nullptr && *home == '/')) {
+		std::string parent = cache != nullptr && *cache == '/' ? cache : std::string(home) + "/.cache";
+		if (mkdir(parent.c_str(), 0700) != 0 && errno != EEXIST) {
+			dir = parent;
+			return false;
+		}
+		dir = parent + "/hysim";
+	} else {
+		const char* tmp = std::getenv("TMPDIR");
+		dir = std::string(tmp != nullptr && *tmp != '\0' ? tmp : "/tmp") + "/hysim-" + std::to_string(geteuid());
+	}
+	return MakePrivateDir(dir);
+}
+
+// a cached object is loaded only if it is a regular file of the user which others cannot write
+bool IsTrusted(const std::string& path) {
+	struct stat st;
+	return lstat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_uid == geteuid() &&
+		(st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+} // namespace
+#endif
+
+bool Aot::Compile(const Program& program) {
+	Release();
+#if !HYS_AOT
+	(void)program;
+	std::cerr << "[warn]: AOT does not support the target." << std::endl;
+	return false;
+#else
+	if (!program.verified) {
+		std::cerr << "[warn]: AOT needs a verified program." << std::endl;
+		return false;
+	}
+	std::string source;
+	if (!Generate(program, source)) {
+		return false;
+	}
+
+	std::string dir = dir_;
+	if (dir.empty() ? !CacheDir(dir) : !MakePrivateDir(dir)) {
+		std::cerr << "[warn]: AOT cache " << dir << " is not a directory of the user which others cannot write." << std::endl;
+		return false;
+	}
+	if (dir.find('\'') != std::string::npos) {
+		std::cerr << "[warn]: AOT cache " << dir << " cannot be quoted for the compiler." << std::endl;
+		return false;
+	}
+	char key[17];
+	std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(Hash(source)));
+	std::string base = dir + "/hysim-" + key;
+	std::string so = base + ".so";
+
+	if (!IsTrusted(so)) {
+		// built to temporary names and renamed into place, a broken object is never cached
+		std::string tmp = base + "." + std::to_string(getpid());
+		std::string cpp = base + ".cpp";
+		std::ofstream file(tmp + ".cpp");
+		file << source;
+		file.close();
+		if (!file || std::rename((tmp + ".cpp").c_str(), cpp.c_str()) != 0) {
+			std::remove((tmp + ".cpp").c_str());
+			std::cerr << "[warn]: AOT cannot write " << cpp << "." << std::endl;
+			return false;
+		}
+		const char* cxx = std::getenv("CXX");
+		std::string cmd = std::string(cxx != nullptr && *cxx != '\0' ? cxx : "c++") +
+			" -std=c++17 -O2 -fwrapv -shared -fPIC -o '" + tmp + ".so' '" + cpp + "'";
+		// the mode of object follows umask, which may let the group write it
+		if (std::system(cmd.c_str()) != 0 || chmod((tmp + ".so").c_str(), 0700) != 0 ||
+			std::rename((tmp + ".so").c_str(), so.c_str()) != 0) {
+			std::remove((tmp + ".so").c_str());
+			std::cerr << "[warn]: AOT cannot build " << so << "." << std::endl;
+			return false;
+		}
+	}
+
+	handle_ = dlopen(so.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (handle_ == nullptr) {
+		std::cerr << "[warn]: AOT cannot load " << so << ": " << dlerror() << std::endl;
+		return false;
+	}
+	entry_ = dlsym(handle_, entryName);
+	if (entry_ == nullptr) {
+		std::cerr << "[warn]: AOT cannot find " << entryName << " in " << so << "." << std::endl;
+		Release();
+		return false;
+	}
+	return true;
+#endif
+}
+
+bool Aot::Run(Cpu& cpu, size_t frameSize, var& ret) {
+#if !HYS_AOT
+	(void)cpu;
+	(void)frameSize;
+	(void)ret;
+	return false;
+#else
+	if (entry_ == nullptr) {
+		return false;
+	}
+	// C++ frames are larger than the ones of control stack, give a native frame 512 bytes
+	Call call{ reinterpret_cast<Entry>(entry_), frameSize, 0LL, nullptr, ERROR };
+	pthread_attr_t attr;
+	pthread_t thread;
+	bool ok = pthread_attr_init(&attr) == 0 &&
+		pthread_attr_setstacksize(&attr, (frameSize + 1) * 512 + (1ULL << 20)) == 0 &&
+		pthread_create(&thread, &attr, RunCall, &call) == 0;
+	pthread_attr_destroy(&attr);
+	if (!ok || pthread_join(thread, nullptr) != 0) {
+		std::cerr << "[err]: AOT cannot start a thread." << std::endl;
+		return false;
+	}
+
+	switch (call.status) {
+	case OK:
+		ret = call.value;
+		break;
+	case EXIT:
+		cpu.exitCode = call.value;
+		std::cout << "[EXIT]: " << cpu.exitCode << std::endl;
+		cpu.exit = true;
+		ret = call.value;
+		break;
+	case HALT:
+		break;
+	default:
+		std::cerr << "[err]: Exec aot failed: " << (call.err == nullptr ? "unknown error." : call.err) << std::endl;
+		return false;
+	}
+	return true;
+#endif
+}
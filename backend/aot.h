@@ -0,0 +1,71 @@
+/**
+ * @file aot.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include "instruction.h"
+#include "regvm.h"
+
+// dlopen and a system compiler are needed, other targets always fall back to interpreter
+#if defined(__unix__)
+#define HYS_AOT 1
+#else
+#define HYS_AOT 0
+#endif
+
+// Ahead-of-time compiler: a verified program is translated to C++ from its register code,
+// each function is a C++ function whose registers are C++ locals, jumps are gotos,
+// and exit or halt is an exception caught at the entry.
+// The shared object is built by the system compiler ($CXX, or c++), and is cached
+// by the hash of source, so a deployed script pays the compile time only once.
+// The cache is a directory of the user which others cannot write, and a cached object
+// is rebuilt unless it is a regular file of the user which others cannot write.
+class Aot {
+public:
+    Aot() = default;
+    Aot(const Aot&) = delete;
+    Aot& operator=(const Aot&) = delete;
+    ~Aot();
+
+    // directory of generated sources and shared objects, $XDG_CACHE_HOME/hysim or ~/.cache/hysim
+    // if empty. It is made with mode 0700 if it does not exist
+    inline void SetDir(const std::string& dir) {
+        dir_ = dir;
+    }
+
+    // false if the program or the target is not supported, the interpreter runs it then
+    bool Compile(const Program& program);
+
+    // frameSize limits the depth of calls as the control stack does
+    bool Run(Cpu& cpu, size_t frameSize, var& ret);
+
+    // C++ source of the program
+    bool Generate(const Program& program, std::string& source);
+
+    // status returned by the entry of shared object
+    enum Status : int {
+        OK = 0,
+        EXIT,
+        HALT,
+        ERROR
+    };
+
+private:
+    void Release();
+
+    std::string dir_;
+    RegVm regVm_;
+    void* handle_{ nullptr };
+    void* entry_{ nullptr };
+};
+
+#endif
@@ -11,8 +11,10 @@
 
 #include "assembler.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 #include "utils.h"
@@ -97,6 +99,32 @@ bool Assembler::Assemble(const std::string& filePath, bool doMain, bool doExit)
         label = "";
     }
     
+    return Encode(code_, program_);
+}
+
+bool Assembler::LoadProfile(const std::string& filePath) {
+    std::ifstream file{ filePath };
+    if (!file) {
+        std::cerr << "[err]: Read profile " << filePath << " failed!" << std::endl;
+        return false;
+    }
+
+    // label taken fallen, of each label jumped to
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string strippedLine = Utils::Trim(line);
+        if (strippedLine.empty() || strippedLine[0] == '#') {
+            continue;
+        }
+        std::istringstream fields{ strippedLine };
+        std::string label;
+        BranchCount count{ 0, 0 };
+        if (!(fields >> label >> count.taken >> count.fallen) || !IsIdentifier(label)) {
+            std::cerr << "[err]: Wrong profile line: " << line << std::endl;
+            return false;
+        }
+        code_.branches[label] = count;
+    }
     return true;
 }
 
@@ -127,5 +155,192 @@ bool Assembler::CheckLabel(const std::string& label) {
         }
     }
 
+    return true;
+}
+
+// Resolve a push/pop operand of function to a frame offset
+static bool ResolveSlot(const std::map<std::string, uint32_t>& slots, 
+    const std::string& name, uint32_t& slot) {
+    auto it = slots.find(name);
+    if (it == slots.end()) {
+        std::cerr << "[err]: Undefined variable " << name << std::endl;
+        return false;
+    }
+    slot = it->second;
+    return true;
+}
+
+bool Assembler::Encode(const Code& code, Program& program) {
+    program.Clear();
+
+    // funcs[0] is the top level code, others are sorted by entry
+    std::vector<std::pair<uint64_t, std::string>> entries;
+    for (const auto& it : code.funcMap) {
+        entries.push_back({ it.second, it.first });
+    }
+    std::sort(entries.begin(), entries.end());
+    std::vector<uint64_t> begins{ 0 };
+    program.funcs.push_back({ "", 0, 0, 0, 0, {} });
+    for (const auto& it : entries) {
+        begins.push_back(it.first);
+        program.funcs.push_back({ it.second, 0, 0, 0, 0, {} });
+    }
+    begins.push_back(code.irs.size());
+
+    std::map<std::string, uint32_t> funcIndexes;
+    for (size_t f = 1; f < program.funcs.size(); f++) {
+        funcIndexes[program.funcs[f].name] = static_cast<uint32_t>(f);
+    }
+
+    // new index of each IR, arg and var are dropped and ret/exit with operand is split to push + ret/exit
+    std::vector<uint64_t> indexes(code.irs.size() + 1, 0);
+    uint64_t index = 0;
+    for (size_t i = 0; i < code.irs.size(); i++) {
+        indexes[i] = index;
+        const auto& ir = code.irs[i];
+        if (ir.instruction == InstructionType::ARG || ir.instruction == InstructionType::VAR) {
+            continue;
+        }
+        bool split = (ir.instruction == InstructionType::RET || ir.instruction == InstructionType::EXIT) &&
+            !ir.argument.empty() && ir.argument != "~";
+        index += split ? 2 : 1;
+    }
+    indexes[code.irs.size()] = index;
+
+    for (size_t f = 0; f < program.funcs.size(); f++) {
+        auto& func = program.funcs[f];
+        func.entry = indexes[begins[f]];
+        func.end = indexes[begins[f + 1]];
+
+        // args and locals to frame slots
+        std::map<std::string, uint32_t> slots;
+        std::vector<std::string> locals;
+        for (uint64_t i = begins[f]; i < begins[f + 1]; i++) {
+            const auto& ir = code.irs[i];
+            if (ir.instruction != InstructionType::ARG && ir.instruction != InstructionType::VAR) {
+                continue;
+            }
+            if (ir.instruction == InstructionType::ARG && (i != begins[f] || f == 0)) {
+                std::cerr << "[err]: Args must be the head of function " << func.name << std::endl;
+                return false;
+            }
+            std::vector<std::string> names;
+            Utils::Split(ir.argument, ",", names);
+            for (const auto& name : names) {
+                if (!IsIdentifier(name) || slots.count(name) == 1) {
+                    std::cerr << "[err]: Wrong variant name " << name << " of function " << func.name << std::endl;
+                    return false;
+                }
+                slots[name] = 0;
+                if (ir.instruction == InstructionType::ARG) {
+                    func.slots.push_back(name);
+                } else {
+                    locals.push_back(name);
+                }
+            }
+        }
+        func.argc = static_cast<uint32_t>(func.slots.size());
+        func.varc = static_cast<uint32_t>(locals.size());
+        func.slots.insert(func.slots.end(), locals.begin(), locals.end());
+        for (uint32_t i = 0; i < func.slots.size(); i++) {
+            slots[func.slots[i]] = i;
+        }
+
+        for (uint64_t i = begins[f]; i < begins[f + 1]; i++) {
+            const auto& ir = code.irs[i];
+            if (!ir.label.empty()) {
+                auto& label = program.labels[indexes[i]];
+                label = label.empty() ? ir.label : label + "," + ir.label;
+            }
+
+            const auto& arg = ir.argument;
+            ByteCode bc{ OpCode::NIL, 0, 0, 0LL };
+            switch (ir.instruction) {
+            case InstructionType::ARG:
+            case InstructionType::VAR:
+                continue;
+            case InstructionType::PUSH:
+                if (Utils::ParseInteger(arg, bc.b)) {
+                    bc.op = OpCode::PUSHI;
+                } else if (ResolveSlot(slots, arg, bc.a)) {
+                    bc.op = OpCode::PUSHL;
+                } else {
+                    return false;
+                }
+                break;
+            case InstructionType::POP:
+                if (arg.empty()) {
+                    bc.op = OpCode::POP;
+                } else if (ResolveSlot(slots, arg, bc.a)) {
+                    bc.op = OpCode::POPL;
+                } else {
+                    return false;
+                }
+                break;
+            case InstructionType::JMP:
+            case InstructionType::JZ: {
+                auto it = code.labelMap.find(arg);
+                if (it == code.labelMap.end()) {
+                    std::cerr << "[err]: Wrong label " << arg << std::endl;
+                    return false;
+                }
+                bc.op = ir.instruction == InstructionType::JMP ? OpCode::JMP : OpCode::JZ;
+                bc.a = static_cast<uint32_t>(indexes[it->second]);
+                break;
+            }
+            case InstructionType::CALL:
+            case InstructionType::TAILCALL: {
+                auto it = funcIndexes.find(arg);
+                if (it == funcIndexes.end()) {
+                    std::cerr << "[err]: Undefined function " << arg << std::endl;
+                    return false;
+                }
+                bc.op = ir.instruction == InstructionType::CALL ? OpCode::CALL : OpCode::TAILCALL;
+                bc.a = it->second;
+                break;
+            }
+            case InstructionType::RET:
+            case InstructionType::EXIT: {
+                bool isRet = ir.instruction == InstructionType::RET;
+                if (arg.empty()) {
+                    bc.op = isRet ? OpCode::RETV : OpCode::EXITV;
+                    break;
+                }
+                if (arg != "~") {
+                    // ret x: push x, ret ~
+                    ByteCode push{ OpCode::PUSHI, 0, 0, 0LL };
+                    if (!Utils::ParseInteger(arg, push.b)) {
+                        if (!ResolveSlot(slots, arg, push.a)) {
+                            return false;
+                        }
+                        push.op = OpCode::PUSHL;
+                    }
+                    program.code.push_back(push);
+                }
+                bc.op = isRet ? OpCode::RET : OpCode::EXIT;
+                break;
+            }
+            case InstructionType::SHL:
+            case InstructionType::SHR:
+            case InstructionType::MASK:
+                if (!Utils::ParseInteger(arg, bc.b) || bc.b < 1 || bc.b > MAX_SHIFT) {
+                    std::cerr << "[err]: Wrong bits " << arg << std::endl;
+                    return false;
+                }
+                bc.op = ir.instruction == InstructionType::SHL ? OpCode::SHLI :
+                    ir.instruction == InstructionType::SHR ? OpCode::SHRI : OpCode::MASKI;
+                break;
+            default:
+                static_assert(static_cast<int>(OpCode::CMPLE) == static_cast<int>(InstructionType::CMPLE));
+                // the arithmetic opcodes have the same order as instructions
+                bc.op = static_cast<OpCode>(static_cast<int>(ir.instruction));
+                break;
+            }
+            program.code.push_back(bc);
+        }
+    }
+    // falling off the end, or jumping to a label at the end, halts
+    program.code.push_back({ OpCode::HALT, 0, 0, 0LL });
+
     return true;
 }
\ No newline at end of file
@@ -18,21 +18,34 @@ class Assembler {
 public:
     bool Assemble(const std::string& filePath, bool doMain = true, bool doExit = false);
 
+    // Resolve the IRs to the binary program form which executor runs
+    static bool Encode(const Code& code, Program& program);
+
+    // counts of jz written by Tracer::Profile of an earlier run, the optimizer lays out
+    // blocks of code by them
+    bool LoadProfile(const std::string& filePath);
+
     inline void Reset() {
         Clear();
     }
 
     inline void Clear() {
         code_.Clear();
+        program_.Clear();
     }
 
     inline const Code& GetCode() const {
         return code_;
     }
 
+    inline const Program& GetProgram() const {
+        return program_;
+    }
+
 private:
     bool CheckLabel(const std::string& label);
     Code code_;
+    Program program_;
 };
 
  #endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+/**
+ * @file emitter.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "emitter.h"
+
+#include <cstring>
+#include <iostream>
+
+#if HYS_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// multiplier and shift of the signed division by divisor, |divisor| >= 2.
+// The least p with 2^p > anc * (d - 2^p % d) gives a multiplier of 2^p / d rounded up,
+// as in Hacker's Delight 10-1
+void Magic(var divisor, var& multiplier, int& shift) {
+	constexpr uint64_t two63 = 1ULL << 63;
+	auto d = static_cast<uint64_t>(divisor);
+	uint64_t ad = divisor < 0 ? 0 - d : d;
+	uint64_t t = two63 + (d >> 63);
+	uint64_t anc = t - 1 - t % ad;
+	uint64_t q1 = two63 / anc;
+	uint64_t r1 = two63 - q1 * anc;
+	uint64_t q2 = two63 / ad;
+	uint64_t r2 = two63 - q2 * ad;
+	uint64_t delta = 0;
+	int p = 63;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc) {
+			q1++;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad) {
+			q2++;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	multiplier = static_cast<var>(divisor < 0 ? 0 - (q2 + 1) : q2 + 1);
+	shift = p - 64;
+}
+
+} // namespace
+
+void Emitter::Byte(uint8_t byte) {
+	buf_.push_back(byte);
+}
+
+void Emitter::Int32(int32_t value) {
+	for (int i = 0; i < 4; i++) {
+		Byte(static_cast<uint8_t>(static_cast<uint32_t>(value) >> (i * 8)));
+	}
+}
+
+void Emitter::Int64(int64_t value) {
+	for (int i = 0; i < 8; i++) {
+		Byte(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (i * 8)));
+	}
+}
+
+void Emitter::Mem(std::initializer_list<uint8_t> opcode, int reg, int base, int32_t disp) {
+	Byte(static_cast<uint8_t>(0x48 | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1)));
+	for (auto byte : opcode) {
+		Byte(byte);
+	}
+	Byte(static_cast<uint8_t>(0x80 | (reg & 7) << 3 | (base & 7)));
+	if ((base & 7) == RSP) {
+		// rsp and r12 as base need SIB
+		Byte(0x24);
+	}
+	Int32(disp);
+}
+
+void Emitter::Reg(std::initializer_list<uint8_t> opcode, int reg, int rm) {
+	Byte(static_cast<uint8_t>(0x48 | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1)));
+	for (auto byte : opcode) {
+		Byte(byte);
+	}
+	Byte(static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7)));
+}
+
+void Emitter::MovImm(int reg, int64_t value) {
+	if (IsInt32(value)) {
+		// mov r64, imm32 sign extended
+		Reg({ 0xC7 }, 0, reg);
+		Int32(static_cast<int32_t>(value));
+		return;
+	}
+	Byte(static_cast<uint8_t>(0x48 | ((reg >> 3) & 1)));
+	Byte(static_cast<uint8_t>(0xB8 + (reg & 7)));
+	Int64(value);
+}
+
+void Emitter::Push(int reg) {
+	if (reg >= 8) {
+		Byte(0x41);
+	}
+	Byte(static_cast<uint8_t>(0x50 + (reg & 7)));
+}
+
+void Emitter::Pop(int reg) {
+	if (reg >= 8) {
+		Byte(0x41);
+	}
+	Byte(static_cast<uint8_t>(0x58 + (reg & 7)));
+}
+
+void Emitter::Jump(std::initializer_list<uint8_t> opcode, uint64_t target, std::vector<std::pair<size_t, uint64_t>>& patches) {
+	for (auto byte : opcode) {
+		Byte(byte);
+	}
+	patches.push_back({ buf_.size(), target });
+	Int32(0);
+}
+
+void Emitter::Patch(size_t at, size_t target) {
+	int32_t rel = static_cast<int32_t>(target - (at + 4));
+	std::memcpy(buf_.data() + at, &rel, sizeof(rel));
+}
+
+bool Emitter::Operate(OpCode op) {
+	switch (op) {
+	case OpCode::ADD:
+		Reg({ 0x01 }, RCX, RAX);
+		break;
+	case OpCode::SUB:
+		Reg({ 0x29 }, RCX, RAX);
+		break;
+	case OpCode::MUL:
+		Reg({ 0x0F, 0xAF }, RAX, RCX);
+		break;
+	case OpCode::DIV:
+	case OpCode::MOD:
+		// cqo; idiv rcx
+		Byte(0x48);
+		Byte(0x99);
+		Reg({ 0xF7 }, 7, RCX);
+		if (op == OpCode::MOD) {
+			Reg({ 0x89 }, RDX, RAX);
+		}
+		break;
+	case OpCode::AND:
+	case OpCode::OR:
+		// setne al; setne cl; and|or al, cl; movzx eax, al
+		Reg({ 0x85 }, RAX, RAX);
+		Byte(0x0F);
+		Byte(0x90 + CC_NE);
+		Byte(0xC0);
+		Reg({ 0x85 }, RCX, RCX);
+		Byte(0x0F);
+		Byte(0x90 + CC_NE);
+		Byte(0xC1);
+		Byte(op == OpCode::AND ? 0x20 : 0x08);
+		Byte(0xC8);
+		Byte(0x0F);
+		Byte(0xB6);
+		Byte(0xC0);
+		break;
+	case OpCode::BITAND:
+		Reg({ 0x21 }, RCX, RAX);
+		break;
+	case OpCode::BITOR:
+		Reg({ 0x09 }, RCX, RAX);
+		break;
+	case OpCode::BITXOR:
+		Reg({ 0x31 }, RCX, RAX);
+		break;
+	case OpCode::CMPEQ:
+	case OpCode::CMPNE:
+	case OpCode::CMPGT:
+	case OpCode::CMPLT:
+	case OpCode::CMPGE:
+	case OpCode::CMPLE:
+		// cmp rax, rcx; setcc al; movzx eax, al
+		Reg({ 0x39 }, RCX, RAX);
+		Byte(0x0F);
+		Byte(static_cast<uint8_t>(0x90 + conditions[static_cast<size_t>(op) - static_cast<size_t>(OpCode::CMPEQ)]));
+		Byte(0xC0);
+		Byte(0x0F);
+		Byte(0xB6);
+		Byte(0xC0);
+		break;
+	default:
+		return false;
+	}
+	return true;
+}
+
+void Emitter::Shift(OpCode op, var bits) {
+	auto count = static_cast<uint8_t>(bits);
+	if (op == OpCode::SHLI) {
+		// shl rax, k
+		Reg({ 0xC1 }, 4, RAX);
+		Byte(count);
+		return;
+	}
+	// rdx = x < 0 ? 2^k - 1 : 0; add rax, rdx
+	Reg({ 0x89 }, RAX, RDX);
+	Reg({ 0xC1 }, 7, RDX);
+	Byte(63);
+	Reg({ 0xC1 }, 5, RDX);
+	Byte(static_cast<uint8_t>(64 - count));
+	Reg({ 0x01 }, RDX, RAX);
+	if (op == OpCode::SHRI) {
+		// sar rax, k
+		Reg({ 0xC1 }, 7, RAX);
+		Byte(count);
+		return;
+	}
+	// and rax, 2^k - 1; sub rax, rdx
+	var mask = (1LL << bits) - 1;
+	if (IsInt32(mask)) {
+		Reg({ 0x81 }, 4, RAX);
+		Int32(static_cast<int32_t>(mask));
+	} else {
+		MovImm(RCX, mask);
+		Reg({ 0x21 }, RCX, RAX);
+	}
+	Reg({ 0x29 }, RDX, RAX);
+}
+
+bool Emitter::Divide(OpCode op, var divisor) {
+	if (divisor >= -1 && divisor <= 1) {
+		return false;
+	}
+	var multiplier = 0;
+	int shift = 0;
+	Magic(divisor, multiplier, shift);
+
+	// mov rcx, rax; mov rax, m; imul rcx, the high half in rdx
+	Reg({ 0x89 }, RAX, RCX);
+	MovImm(RAX, multiplier);
+	Reg({ 0xF7 }, 5, RCX);
+	// the multiplier wrapped to the other sign is corrected by x
+	if (divisor > 0 && multiplier < 0) {
+		Reg({ 0x01 }, RCX, RDX);
+	} else if (divisor < 0 && multiplier > 0) {
+		Reg({ 0x29 }, RCX, RDX);
+	}
+	if (shift > 0) {
+		Reg({ 0xC1 }, 7, RDX);
+		Byte(static_cast<uint8_t>(shift));
+	}
+	// a negative quotient is rounded toward zero: rax = rdx + (rdx >>> 63)
+	Reg({ 0x89 }, RDX, RAX);
+	Reg({ 0xC1 }, 5, RAX);
+	Byte(63);
+	Reg({ 0x01 }, RDX, RAX);
+	if (op == OpCode::MOD || op == OpCode::MODI) {
+		// rax = x - q * d
+		if (IsInt32(divisor)) {
+			Reg({ 0x69 }, RAX, RAX);
+			Int32(static_cast<int32_t>(divisor));
+		} else {
+			MovImm(RDX, divisor);
+			Reg({ 0x0F, 0xAF }, RAX, RDX);
+		}
+		Reg({ 0x29 }, RAX, RCX);
+		Reg({ 0x89 }, RCX, RAX);
+	}
+	return true;
+}
+
+void* Emitter::Install(size_t& size) {
+#if !HYS_JIT
+	size = 0;
+	return nullptr;
+#else
+	size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size = (buf_.size() + page - 1) / page * page;
+	void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		std::cerr << "[warn]: JIT cannot map code." << std::endl;
+		return nullptr;
+	}
+	std::memcpy(mem, buf_.data(), buf_.size());
+	if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(mem, size);
+		std::cerr << "[warn]: JIT cannot protect code." << std::endl;
+		return nullptr;
+	}
+	return mem;
+#endif
+}
+
+void Emitter::Uninstall(void* code, size_t size) {
+#if HYS_JIT
+	if (code != nullptr) {
+		munmap(code, size);
+	}
+#else
+	(void)code;
+	(void)size;
+#endif
+}
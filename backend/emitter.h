@@ -0,0 +1,102 @@
+/**
+ * @file emitter.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <initializer_list>
+#include <utility>
+
+#include "instruction.h"
+
+// x86-64 machine code and mmap are needed, other targets always fall back to interpreter
+#if defined(__x86_64__) && defined(__linux__)
+#define HYS_JIT 1
+#else
+#define HYS_JIT 0
+#endif
+
+// Encoder of the x86-64 instructions used by the JITs, code is built in buf_
+// and then copied to executable pages.
+class Emitter {
+protected:
+    // numbers of registers in ModRM and REX
+    enum Register : int {
+        RAX = 0,
+        RCX = 1,
+        RDX = 2,
+        RBX = 3,
+        RSP = 4,
+        RBP = 5,
+        RSI = 6,
+        RDI = 7,
+        R8 = 8,
+        R9 = 9,
+        R10 = 10,
+        R11 = 11,
+        R12 = 12,
+        R13 = 13,
+        R14 = 14,
+        R15 = 15
+    };
+
+    // condition codes of setcc and jcc
+    enum Condition : uint8_t {
+        CC_O = 0x0,
+        CC_NO = 0x1,
+        CC_E = 0x4,
+        CC_NE = 0x5,
+        CC_BE = 0x6,
+        CC_L = 0xC,
+        CC_GE = 0xD,
+        CC_LE = 0xE,
+        CC_G = 0xF
+    };
+
+    // of cmpeq ~ cmple
+    static constexpr uint8_t conditions[] = { CC_E, CC_NE, CC_G, CC_L, CC_GE, CC_LE };
+    // jz jumps when the comparison is false
+    static constexpr uint8_t inverses[] = { CC_NE, CC_E, CC_LE, CC_GE, CC_L, CC_G };
+
+    static inline bool IsInt32(int64_t value) {
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    void Byte(uint8_t byte);
+    void Int32(int32_t value);
+    void Int64(int64_t value);
+    // op with a register and memory [base + disp32]
+    void Mem(std::initializer_list<uint8_t> opcode, int reg, int base, int32_t disp);
+    // op with two registers, reg and rm of ModRM
+    void Reg(std::initializer_list<uint8_t> opcode, int reg, int rm);
+    void MovImm(int reg, int64_t value);
+    // push or pop of a 64-bit register
+    void Push(int reg);
+    void Pop(int reg);
+    // rel32 is patched after all code is emitted
+    void Jump(std::initializer_list<uint8_t> opcode, uint64_t target, std::vector<std::pair<size_t, uint64_t>>& patches);
+    void Patch(size_t at, size_t target);
+    // binary operator of rax and rcx, the result is in rax. The divisor is checked by caller
+    bool Operate(OpCode op);
+    // shli, shri or maski of rax by bits, rcx and rdx are clobbered
+    void Shift(OpCode op, var bits);
+    // rax div or mod divisor by a multiply with its magic number, not idiv.
+    // false if |divisor| < 2, rcx and rdx are clobbered
+    bool Divide(OpCode op, var divisor);
+
+    // copy buf_ to executable pages, nullptr if failed
+    void* Install(size_t& size);
+    static void Uninstall(void* code, size_t size);
+
+    std::vector<uint8_t> buf_;
+};
+
+#endif
@@ -1,151 +1,715 @@
 /**
  * @file executor.cpp
  * @author Hu Yong (huyongcode@outlook.com)
- * @brief 
+ * @brief
  * @version 0.1
  * @date 2025-04-10
- * 
+ *
  * @copyright huyong Copyright (c) 2025
- * 
+ *
  */
 
 #include "executor.h"
 
 #include <iostream>
+#include <iterator>
+#include <string>
 
-bool Executor::Run(const Code& code, var& ret) {
+bool Executor::Run(const Program& program, var& ret) {
 	cpu_.Clear();
-	while (!cpu_.exit && cpu_.ip < code.irs.size()) {
-		InstructionType instType = code.irs[cpu_.ip].instruction;
-		if (instType == InstructionType::NIL || instType == InstructionType::MAX) {
-			std::cerr << "[err]: Instruction is error." << std::endl;
-			return false;
+	if (!Check(program)) {
+		return false;
+	}
+	// verified code runs on the unchecked handlers, without tags of stack items
+	bool checked = checked_ || !program.verified;
+	cpu_.stack.resize(stackSize_, 0LL);
+	if (checked) {
+		cpu_.tags.resize(stackSize_, StackItemType::UNINIT);
+	}
+	cpu_.frames.resize(frameSize_, { 0, 0, 0 });
+	// frame of the top level code, every engine below runs it on cpu_.stack
+	if (program.funcs[0].varc + program.funcs[0].maxStack + 1 > stackSize_) {
+		std::cerr << "[err]: Stack overflow." << std::endl;
+		return false;
+	}
+
+	if (aot_ && !checked && (tracer_ == nullptr || !tracer_->IsActive())) {
+		if (compiled_.Compile(program)) {
+			return compiled_.Run(cpu_, frameSize_, ret);
+		}
+		std::cerr << "[warn]: Run without AOT." << std::endl;
+	}
+	if (jit_ && !checked && (tracer_ == nullptr || !tracer_->IsActive())) {
+		if (native_.Compile(program)) {
+			return native_.Run(cpu_, frameSize_, ret);
+		}
+		std::cerr << "[warn]: Run on the interpreter." << std::endl;
+	}
+	// branches are counted by the stack code only
+	bool profile = tracer_ != nullptr && tracer_->IsProfile();
+	if (register_ && !checked && !profile) {
+		if (regVm_.Translate(program)) {
+			if (tracer_ != nullptr && tracer_->IsOn(TraceLevel::INSTS)) {
+				regVm_.GetProgram().Print();
+			}
+			return regVm_.Run(cpu_, tracer_, ret);
 		}
-		auto& funcName = instructionInfos[static_cast<size_t>(instType)].str;
-		auto& func = instructionInfos[static_cast<size_t>(instType)].func;
-		
-		std::cout << "********prev********" << std::endl;
-		cpu_.Print();
+		std::cerr << "[warn]: Run on the stack code." << std::endl;
+	}
 
-		std::cout << "********run:" << code.irs[cpu_.ip].label << "\t" <<
-			funcName << "\t" << code.irs[cpu_.ip].argument << std::endl;
+	// unchecked code caches the stack top in a register, a frame has a phantom slot for it
+	cpu_.sp = program.funcs[0].varc + (checked ? 0 : 1);
 
-		// instruction arg's func is null
-		if (func != nullptr && !func(cpu_, code)) {
-			std::cerr << "[err]: Exec " << code.irs[cpu_.ip].label << " " << funcName << " " <<
-				code.irs[cpu_.ip].argument << " failed." << std::endl;
-			return false;
+	bool tier = (tiered_ || tracing_) && !checked && !profile;
+	if (tier) {
+		tierState_ = TierState::UNTRIED;
+		calls_.assign(program.funcs.size(), 0);
+		loops_.assign(program.code.size(), 0);
+		traceJit_.Reset(program);
+	}
+
+	if (tracer_ == nullptr || !tracer_->IsActive()) {
+		if (checked) {
+			return Exec<false, true, false>(program, ret);
+		}
+		return tier ? Exec<false, false, true>(program, ret) : Exec<false, false, false>(program, ret);
+	}
+	bool ok = checked ? Exec<true, true, false>(program, ret) :
+		tier ? Exec<true, false, true>(program, ret) : Exec<true, false, false>(program, ret);
+	tracer_->Flush();
+	return ok;
+}
+
+bool Executor::Tier(const Program& program) {
+	if (tierState_ == TierState::UNTRIED) {
+		tierState_ = regVm_.Translate(program) ? TierState::READY : TierState::FAILED;
+		if (tierState_ == TierState::FAILED) {
+			std::cerr << "[warn]: Tiering is off, register code is not translated." << std::endl;
 		}
-		
-		std::cout << "********post********" << std::endl;
-		cpu_.Print();
+	}
+	return tierState_ == TierState::READY;
+}
 
-		cpu_.ip += 1;
+bool Executor::Promote(const Program& program, uint32_t funcIdx) {
+	if (!Tier(program)) {
+		return false;
+	}
+	if (calls_[funcIdx] == callThreshold_) {
+		std::cerr << "[tier]: promote " << program.funcs[funcIdx].name << " after " <<
+			calls_[funcIdx] << " calls" << std::endl;
 	}
+	return true;
+}
+
+// the loop is named by its head label, e.g. _begWhile_1
+static std::string LoopName(const Program& program, uint64_t ip, uint32_t funcIdx) {
+	auto it = program.labels.upper_bound(ip);
+	std::string loop = it == program.labels.begin() ? std::to_string(ip) : std::prev(it)->second;
+	return (funcIdx == 0 ? std::string("<top>") : program.funcs[funcIdx].name) + " at " + loop;
+}
 
+bool Executor::Osr(const Program& program, uint64_t ip, uint32_t funcIdx, uint64_t depth) {
+	const auto& func = program.funcs[funcIdx];
+	if (depth != func.argc + func.varc || !Tier(program)) {
+		return false;
+	}
+	if (loops_[ip] == loopThreshold_) {
+		std::cerr << "[tier]: osr " << LoopName(program, ip, funcIdx) <<
+			" after " << loops_[ip] << " iterations" << std::endl;
+	}
 	return true;
 }
 
-//static bool Add(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Sub(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Mul(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Div(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Mod(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Neg(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Not(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool And(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Or(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool BitAnd(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool BitOr(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool BitXor(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpEq(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpNe(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpGt(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpLt(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpGe(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool CmpLe(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Push(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Pop(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Jmp(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Jz(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Var(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Call(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Ret(Cpu& cpu, const Code& code) {
-//	return true;
-//}
-//
-//static bool Exit(Cpu& cpu, const Code& code) {
-//	return true;
-//}
\ No newline at end of file
+bool Executor::Trace(const Program& program, uint64_t ip, uint32_t funcIdx, uint64_t depth, const var* bp) {
+	if (traceJit_.GetState(ip) == TraceJit::State::UNTRIED &&
+		traceJit_.Record(program, ip, funcIdx, depth, bp)) {
+		std::cerr << "[tier]: trace " << LoopName(program, ip, funcIdx) << " after " << loops_[ip] <<
+			" iterations, " << traceJit_.GetLength(ip) << " instructions" << std::endl;
+	}
+	return traceJit_.GetState(ip) == TraceJit::State::READY;
+}
+
+bool Executor::Check(const Program& program) {
+	if (program.code.empty() || program.code.back().op != OpCode::HALT || program.funcs.empty()) {
+		std::cerr << "[err]: Code is not end with halt." << std::endl;
+		return false;
+	}
+	for (size_t i = 0; i < program.code.size(); i++) {
+		const auto& bc = program.code[i];
+		bool ok = bc.op > OpCode::NIL && bc.op < OpCode::MAX;
+		switch (bc.op) {
+		case OpCode::JMP:
+		case OpCode::JZ:
+		case OpCode::JZEQLI:
+		case OpCode::JZNELI:
+		case OpCode::JZGTLI:
+		case OpCode::JZLTLI:
+		case OpCode::JZGELI:
+		case OpCode::JZLELI:
+			ok = bc.a < program.code.size();
+			break;
+		case OpCode::DIVI:
+		case OpCode::MODI:
+			ok = bc.b != 0LL;
+			break;
+		case OpCode::SHLI:
+		case OpCode::SHRI:
+		case OpCode::MASKI:
+			ok = bc.b >= 1 && bc.b <= MAX_SHIFT;
+			break;
+		case OpCode::CALL:
+		case OpCode::TAILCALL:
+			ok = bc.a > 0 && bc.a < program.funcs.size() &&
+				program.funcs[bc.a].entry < program.code.size();
+			break;
+		default:
+			break;
+		}
+		if (!ok) {
+			std::cerr << "[err]: Instruction " << i << " is error." << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+template <bool kTrace, bool kChecked, bool kTier>
+bool Executor::Exec(const Program& program, var& ret) {
+	static_assert(!kTier || !kChecked, "register code runs verified program only");
+	const ByteCode* const code = program.code.data();
+	const FuncInfo* const funcs = program.funcs.data();
+	var* const stack = cpu_.stack.data();
+	var* const limit = stack + cpu_.stack.size();
+	// tags of stack items, only kept by the checked instantiation
+	StackItemType* const tags = cpu_.tags.data();
+	Frame* const frames = cpu_.frames.data();
+	Frame* const frameLimit = frames + cpu_.frames.size();
+
+	// registers of the loop, written back to cpu_ when leaving
+	const ByteCode* pc = code + cpu_.ip;
+	var* sp = stack + cpu_.sp;
+	var* bp = stack + cpu_.bp;
+	Frame* fp = frames + cpu_.fp;
+	const char* err = nullptr;
+
+	// Top of stack caching of the unchecked instantiation: the stack top lives in tos,
+	// and memory keeps the items below it. The first push of a frame spills tos to the
+	// phantom slot above locals, so tos is never a local, and cpu_.sp counts the phantom.
+	constexpr bool kCached = !kChecked;
+	[[maybe_unused]] var tos = 0LL;
+	if constexpr (kCached) {
+		tos = *--sp;
+	}
+	// value returned by the frame, from ret or register code
+	var retValue = 0LL;
+	[[maybe_unused]] StackItemType retTag = StackItemType::UNINIT;
+
+#define SYNC() do { \
+	cpu_.ip = pc - code; \
+	if constexpr (kCached) { \
+		*sp = tos; \
+		cpu_.sp = sp - stack + 1; \
+	} else { \
+		cpu_.sp = sp - stack; \
+	} \
+	cpu_.bp = bp - stack; \
+	cpu_.fp = fp - frames; \
+} while (0)
+#define FAIL(msg) do { err = (msg); goto fail; } while (0)
+// compiled out of the unchecked instantiation, its conditions are proved by verifier
+#define CHECK(cond, msg) do { \
+	if constexpr (kChecked) { \
+		if (cond) { \
+			FAIL(msg); \
+		} \
+	} \
+} while (0)
+
+#define TAG(p) tags[(p) - stack]
+#define SET_TAG(p, t) do { \
+	if constexpr (kChecked) { \
+		TAG(p) = (t); \
+	} \
+} while (0)
+
+// compiled out of the non-tracing instantiation
+#define TRACE() do { \
+	if constexpr (kTrace) { \
+		if (tracer_->IsStats()) { \
+			tracer_->Count(pc->op); \
+		} \
+		if (tracer_->IsOn(TraceLevel::INSTS)) { \
+			SYNC(); \
+			if (tracer_->IsOn(TraceLevel::FULL)) { \
+				tracer_->State(cpu_); \
+			} \
+			tracer_->Inst(program, cpu_.ip); \
+		} \
+	} \
+} while (0)
+
+// a jz of the ip from went to its target or fell through, for a profile
+#define PROFILE(from, taken) do { \
+	if constexpr (kTrace) { \
+		if (tracer_->IsProfile()) { \
+			tracer_->Branch((from) - code, (taken)); \
+		} \
+	} \
+} while (0)
+
+#if HYS_COMPUTED_GOTO
+	static const void* const labels[] = {
+		&&L_NIL, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD, &&L_NEG, &&L_NOT,
+		&&L_AND, &&L_OR, &&L_BITAND, &&L_BITOR, &&L_BITXOR,
+		&&L_CMPEQ, &&L_CMPNE, &&L_CMPGT, &&L_CMPLT, &&L_CMPGE, &&L_CMPLE,
+		&&L_PUSHI, &&L_PUSHL, &&L_POPL, &&L_POP, &&L_JMP, &&L_JZ,
+		&&L_CALL, &&L_TAILCALL, &&L_RET, &&L_RETV, &&L_EXIT, &&L_EXITV, &&L_HALT,
+		&&L_INCL, &&L_MOVL, &&L_MOVI, &&L_PUSHLL,
+		&&L_ADDI, &&L_SUBI, &&L_MULI, &&L_DIVI, &&L_MODI,
+		&&L_SHLI, &&L_SHRI, &&L_MASKI,
+		&&L_JZEQLI, &&L_JZNELI, &&L_JZGTLI, &&L_JZLTLI, &&L_JZGELI, &&L_JZLELI
+	};
+	static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<size_t>(OpCode::MAX));
+#define DISPATCH() do { TRACE(); goto *labels[static_cast<size_t>(pc->op)]; } while (0)
+#define HANDLER(op) L_##op
+#else
+#define DISPATCH() do { TRACE(); goto dispatch; } while (0)
+#define HANDLER(op) case OpCode::op
+#endif
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+
+// the top two items, wherever they live
+#define TOP() (*(kCached ? &tos : sp - 1))
+#define SECOND() (*(kCached ? sp - 1 : sp - 2))
+#define PUSH(value) do { \
+	const var pushed = (value); \
+	SET_TAG(sp, StackItemType::CONST); \
+	if constexpr (kCached) { \
+		*sp++ = tos; \
+		tos = pushed; \
+	} else { \
+		*sp++ = pushed; \
+	} \
+} while (0)
+#define DROP() do { \
+	if constexpr (kCached) { \
+		tos = *--sp; \
+	} else { \
+		--sp; \
+	} \
+} while (0)
+
+#define BINARY(name, expr) { \
+	CHECK(sp - stack < 2, name ": stack is not enough."); \
+	CHECK(TAG(sp - 2) != StackItemType::CONST || TAG(sp - 1) != StackItemType::CONST, \
+		name ": operand is not CONST."); \
+	const var left = SECOND(); \
+	const var right = TOP(); \
+	--sp; \
+	TOP() = (expr); \
+	NEXT(); \
+}
+
+#define DIVIDE(name, expr) { \
+	if (!kChecked || sp - stack >= 2) { \
+		if (TOP() == 0LL) { \
+			FAIL(name ": divided by zero."); \
+		} \
+		if (IsOverflow(SECOND(), TOP())) { \
+			FAIL(name ": overflow."); \
+		} \
+	} \
+	BINARY(name, expr) \
+}
+
+#define UNARY(name, expr) { \
+	CHECK(sp - stack < 1, name ": stack is not enough."); \
+	var& right = TOP(); \
+	right = (expr); \
+	NEXT(); \
+}
+
+// the local is read as pushl checks it
+#define CHECK_LOCAL(name, slot) do { \
+	CHECK(bp + (slot) >= sp, name ": Undefined variable."); \
+	CHECK(TAG(bp + (slot)) != StackItemType::CONST, name ": Cannot push uninitialed value."); \
+} while (0)
+
+// binary operator with the right operand as immediate
+#define IMMEDIATE(name, expr) { \
+	CHECK(sp == stack, name ": stack is not enough."); \
+	CHECK(TAG(sp - 1) != StackItemType::CONST, name ": operand is not CONST."); \
+	var& left = TOP(); \
+	const var right = pc->b; \
+	left = (expr); \
+	NEXT(); \
+}
+
+// jz of comparing local with immediate, without touching stack
+#define BRANCH(name, cmp) { \
+	CHECK_LOCAL(name, pc->c); \
+	[[maybe_unused]] const ByteCode* from = pc; \
+	const bool fallen = bp[pc->c] cmp pc->b; \
+	pc = fallen ? pc + 1 : code + pc->a; \
+	PROFILE(from, !fallen); \
+	LOOP(from); \
+	DISPATCH(); \
+}
+
+// a taken backward jump is an iteration of the loop at its target. A traced loop runs
+// in machine code until a guard fails, and the frame of a hot loop which cannot be traced
+// continues in register code until it returns
+#define LOOP(from) do { \
+	if constexpr (kTier) { \
+		if (pc <= (from) && ++loops_[pc - code] >= loopThreshold_) { \
+			const uint32_t funcIdx = fp == frames ? 0 : fp[-1].func; \
+			uint64_t next = 0; \
+			if (tracing_ && Trace(program, pc - code, funcIdx, sp - bp, bp)) { \
+				bool overflow = false; \
+				bool ok = traceJit_.Run(pc - code, bp, next, overflow); \
+				pc = code + next; \
+				if (!ok) { \
+					FAIL(pc->op == OpCode::MOD ? (overflow ? "Mod: overflow." : "Mod: divided by zero.") : \
+						(overflow ? "Div: overflow." : "Div: divided by zero.")); \
+				} \
+			} else if (tiered_ && (!tracing_ || traceJit_.GetState(pc - code) == TraceJit::State::FAILED) && \
+				Osr(program, pc - code, funcIdx, sp - bp)) { \
+				var value = 0LL; \
+				RegVm::Leave leave = RegVm::Leave::HALT; \
+				if (!regVm_.Enter(cpu_, regVm_.GetIndex(pc - code), bp - stack, fp - frames, value, leave)) { \
+					SYNC(); \
+					return false; \
+				} \
+				if (leave != RegVm::Leave::RETURN) { \
+					goto done; \
+				} \
+				retValue = value; \
+				goto leave_frame; \
+			} \
+		} \
+	} \
+} while (0)
+
+	DISPATCH();
+
+#if !HYS_COMPUTED_GOTO
+dispatch:
+	switch (pc->op) {
+#endif
+
+	HANDLER(ADD): BINARY("Add", WrapAdd(left, right))
+	HANDLER(SUB): BINARY("Sub", WrapSub(left, right))
+	HANDLER(MUL): BINARY("Mul", WrapMul(left, right))
+	HANDLER(DIV): DIVIDE("Div", left / right)
+	HANDLER(MOD): DIVIDE("Mod", left % right)
+	HANDLER(NEG): UNARY("Neg", WrapSub(0LL, right))
+	HANDLER(NOT): UNARY("Not", !right)
+	HANDLER(AND): BINARY("And", left && right)
+	HANDLER(OR): BINARY("Or", left || right)
+	HANDLER(BITAND): BINARY("BitAnd", left & right)
+	HANDLER(BITOR): BINARY("BitOr", left | right)
+	HANDLER(BITXOR): BINARY("BitXor", left ^ right)
+	HANDLER(CMPEQ): BINARY("CmpEq", left == right)
+	HANDLER(CMPNE): BINARY("CmpNe", left != right)
+	HANDLER(CMPGT): BINARY("CmpGt", left > right)
+	HANDLER(CMPLT): BINARY("CmpLt", left < right)
+	HANDLER(CMPGE): BINARY("CmpGe", left >= right)
+	HANDLER(CMPLE): BINARY("CmpLe", left <= right)
+
+	HANDLER(PUSHI): {
+		CHECK(sp == limit, "PushI: stack overflow.");
+		PUSH(pc->b);
+		NEXT();
+	}
+
+	// push the value of local, frame offset is resolved by assembler.
+	// Verified code never reads an unassigned local, so only the checked handlers test it.
+	HANDLER(PUSHL): {
+		const var* src = bp + pc->a;
+		CHECK(src >= sp, "PushL: Undefined variable.");
+		CHECK(TAG(src) != StackItemType::CONST, "PushL: Cannot push uninitialed value.");
+		CHECK(sp == limit, "PushL: stack overflow.");
+		PUSH(*src);
+		NEXT();
+	}
+
+	// Assign value and pop
+	HANDLER(POPL): {
+		var* dst = bp + pc->a;
+		CHECK(dst + 1 >= sp, "PopL: Undefined variable.");
+		CHECK(TAG(sp - 1) != StackItemType::CONST, "PopL: Cannot pop non-number value to variable.");
+		SET_TAG(dst, StackItemType::CONST);
+		*dst = TOP();
+		DROP();
+		NEXT();
+	}
+
+	// Discard the stack top, e.g. the result of a call statement
+	HANDLER(POP): {
+		CHECK(sp == stack, "Pop: stack is not enough.");
+		DROP();
+		NEXT();
+	}
+
+	HANDLER(JMP): {
+		[[maybe_unused]] const ByteCode* from = pc;
+		pc = code + pc->a;
+		LOOP(from);
+		DISPATCH();
+	}
+
+	// the condition is consumed whether jumping or not
+	HANDLER(JZ): {
+		CHECK(sp == stack, "Jz: stack is not enough.");
+		CHECK(TAG(sp - 1) != StackItemType::CONST, "Jz: stack top data type is not CONST.");
+		const var cond = TOP();
+		DROP();
+		[[maybe_unused]] const ByteCode* from = pc;
+		pc = cond == 0LL ? code + pc->a : pc + 1;
+		PROFILE(from, cond == 0LL);
+		LOOP(from);
+		DISPATCH();
+	}
+
+	// args are the top argc items of stack, and become the head of callee's frame
+	HANDLER(CALL): {
+		const FuncInfo& callee = funcs[pc->a];
+		CHECK(sp - bp < callee.argc, "Call: stack is not enough for args.");
+		// verified code reserves the whole frame here, instead of checking every push
+		if (static_cast<uint64_t>(limit - sp) < callee.varc + (kChecked ? 0 : callee.maxStack + 2) ||
+			fp == frameLimit) {
+			FAIL("Call: stack overflow.");
+		}
+		if constexpr (kTrace) {
+			if (tracer_->IsOn(TraceLevel::CALLS)) {
+				tracer_->Call(program, pc - code, pc->a, fp - frames);
+			}
+		}
+
+		if constexpr (kTier) {
+			if (tiered_ && ++calls_[pc->a] >= callThreshold_ && Promote(program, pc->a)) {
+				// the callee is set up as in register code, and runs there until it returns
+				*sp++ = tos;
+				var* args = sp - callee.argc;
+				for (uint32_t i = 0; i < callee.varc; i++) {
+					*sp++ = 0LL;
+				}
+				var value = 0LL;
+				RegVm::Leave leave = RegVm::Leave::HALT;
+				if (!regVm_.Enter(cpu_, regVm_.GetEntry(pc->a), args - stack, fp - frames, value, leave)) {
+					SYNC();
+					return false;
+				}
+				if (leave != RegVm::Leave::RETURN) {
+					goto done;
+				}
+				sp = args;
+				tos = value;
+				NEXT();
+			}
+		}
+
+		// reserve caller's info
+		*fp++ = { static_cast<uint64_t>(pc - code), static_cast<uint64_t>(bp - stack), pc->a };
+
+		// set callee's info, the whole frame is sized by the function header
+		if constexpr (kCached) {
+			// the last arg joins the others, tos becomes the phantom of callee
+			*sp++ = tos;
+		}
+		bp = sp - callee.argc;
+		for (uint32_t i = 0; i < callee.varc; i++) {
+			SET_TAG(sp, StackItemType::UNINIT);
+			*sp++ = 0LL;
+		}
+		pc = code + callee.entry;
+		DISPATCH();
+	}
+
+	// args of callee replace the frame, the caller's info is kept so callee returns to it.
+	// A tail recursion runs in the same frame as a loop
+	HANDLER(TAILCALL): {
+		const FuncInfo& callee = funcs[pc->a];
+		CHECK(sp - bp < callee.argc, "TailCall: stack is not enough for args.");
+		CHECK(fp == frames, "TailCall: no frame to reuse.");
+		if constexpr (kCached) {
+			*sp++ = tos;
+		}
+		var* args = sp - callee.argc;
+		for (uint32_t i = 0; i < callee.argc; i++) {
+			SET_TAG(bp + i, TAG(args + i));
+			bp[i] = args[i];
+		}
+		sp = bp + callee.argc;
+		if (static_cast<uint64_t>(limit - sp) < callee.varc + (kChecked ? 0 : callee.maxStack + 2)) {
+			FAIL("TailCall: stack overflow.");
+		}
+		if constexpr (kTrace) {
+			if (tracer_->IsOn(TraceLevel::CALLS)) {
+				tracer_->Call(program, pc - code, pc->a, fp - frames);
+			}
+		}
+
+		(fp - 1)->func = pc->a;
+		for (uint32_t i = 0; i < callee.varc; i++) {
+			SET_TAG(sp, StackItemType::UNINIT);
+			*sp++ = 0LL;
+		}
+		pc = code + callee.entry;
+		DISPATCH();
+	}
+
+	// the frame of callee is dropped and replaced with the return value
+	HANDLER(RET):
+	HANDLER(RETV): {
+		retValue = 0LL;
+		retTag = StackItemType::UNINIT;
+		if (pc->op == OpCode::RET) {
+			CHECK(sp == stack, "Ret: stack is not enough.");
+			retValue = TOP();
+			if constexpr (kChecked) {
+				retTag = TAG(sp - 1);
+			}
+		}
+		goto leave_frame;
+	}
+
+leave_frame:
+	{
+		sp = bp;
+		if constexpr (kCached) {
+			tos = retValue;
+		} else {
+			SET_TAG(sp, retTag);
+			*sp++ = retValue;
+		}
+		if (fp == frames) {
+			// return from the top level code
+			goto done;
+		}
+
+		--fp;
+		bp = stack + fp->bp;
+		pc = code + fp->ip + 1;
+		if constexpr (kTrace) {
+			if (tracer_->IsOn(TraceLevel::CALLS)) {
+				tracer_->Ret(program, pc - code, fp->func, retValue, fp - frames);
+			}
+		}
+		DISPATCH();
+	}
+
+	HANDLER(EXIT): {
+		CHECK(sp == stack, "Exit: stack is not enough.");
+		cpu_.exitCode = TOP();
+		std::cout << "[EXIT]: " << cpu_.exitCode << std::endl;
+		cpu_.exit = true;
+		goto done;
+	}
+
+	HANDLER(EXITV): {
+		cpu_.exitCode = 0LL;
+		std::cout << "[EXIT]: " << cpu_.exitCode << std::endl;
+		cpu_.exit = true;
+		goto done;
+	}
+
+	HANDLER(HALT): {
+		goto done;
+	}
+
+	// superinstructions, each one does what its sequence does
+	HANDLER(INCL): {
+		CHECK_LOCAL("IncL", pc->a);
+		bp[pc->a] = WrapAdd(bp[pc->a], pc->b);
+		NEXT();
+	}
+
+	HANDLER(MOVL): {
+		var* dst = bp + pc->a;
+		CHECK_LOCAL("MovL", pc->c);
+		CHECK(dst >= sp, "MovL: Undefined variable.");
+		SET_TAG(dst, StackItemType::CONST);
+		*dst = bp[pc->c];
+		NEXT();
+	}
+
+	HANDLER(MOVI): {
+		var* dst = bp + pc->a;
+		CHECK(dst >= sp, "MovI: Undefined variable.");
+		SET_TAG(dst, StackItemType::CONST);
+		*dst = pc->b;
+		NEXT();
+	}
+
+	HANDLER(PUSHLL): {
+		CHECK_LOCAL("PushLL", pc->a);
+		CHECK_LOCAL("PushLL", pc->c);
+		CHECK(limit - sp < 2, "PushLL: stack overflow.");
+		PUSH(bp[pc->a]);
+		PUSH(bp[pc->c]);
+		NEXT();
+	}
+
+	HANDLER(ADDI): IMMEDIATE("AddI", WrapAdd(left, right))
+	HANDLER(SUBI): IMMEDIATE("SubI", WrapSub(left, right))
+	HANDLER(MULI): IMMEDIATE("MulI", WrapMul(left, right))
+	// fuser keeps div and mod by zero or -1 as they are
+	HANDLER(DIVI): IMMEDIATE("DivI", left / right)
+	HANDLER(MODI): IMMEDIATE("ModI", left % right)
+	HANDLER(SHLI): IMMEDIATE("ShlI", ShiftLeft(left, right))
+	HANDLER(SHRI): IMMEDIATE("ShrI", ShiftRight(left, right))
+	HANDLER(MASKI): IMMEDIATE("MaskI", Mask(left, right))
+
+	HANDLER(JZEQLI): BRANCH("JzEqLI", ==)
+	HANDLER(JZNELI): BRANCH("JzNeLI", !=)
+	HANDLER(JZGTLI): BRANCH("JzGtLI", >)
+	HANDLER(JZLTLI): BRANCH("JzLtLI", <)
+	HANDLER(JZGELI): BRANCH("JzGeLI", >=)
+	HANDLER(JZLELI): BRANCH("JzLeLI", <=)
+
+	HANDLER(NIL): {
+		FAIL("Instruction is error.");
+	}
+
+#if !HYS_COMPUTED_GOTO
+	default:
+		FAIL("Instruction is error.");
+	}
+#endif
+
+done:
+	SYNC();
+	if (cpu_.sp > 0) {
+		ret = cpu_.stack[cpu_.sp - 1];
+	}
+	return true;
+
+fail:
+	SYNC();
+	std::cerr << "[err]: Exec " << cpu_.ip << " " << opCodeInfos[static_cast<size_t>(pc->op)].str <<
+		" " << pc->a << " " << pc->b << " failed: " << err << std::endl;
+	return false;
+
+#undef SYNC
+#undef FAIL
+#undef CHECK
+#undef TAG
+#undef SET_TAG
+#undef TRACE
+#undef PROFILE
+#undef DISPATCH
+#undef HANDLER
+#undef NEXT
+#undef BINARY
+#undef DIVIDE
+#undef UNARY
+#undef CHECK_LOCAL
+#undef TOP
+#undef SECOND
+#undef PUSH
+#undef DROP
+#undef IMMEDIATE
+#undef BRANCH
+#undef LOOP
+}
@@ -12,75 +12,119 @@
 #ifndef EXECUTOR_H
 #define EXECUTOR_H
 
-#include <functional>
-
+#include "aot.h"
 #include "instruction.h"
+#include "jit.h"
+#include "regvm.h"
+#include "tracejit.h"
+#include "tracer.h"
+
+// default capacity of operand stack, in items
+constexpr size_t DEFAULT_STACK_SIZE = 1ULL << 20;
+// default capacity of control stack, in frames
+constexpr size_t DEFAULT_FRAME_SIZE = 1ULL << 18;
+// default counts of calls and loop iterations before tiering up
+constexpr uint64_t DEFAULT_CALL_THRESHOLD = 1000;
+constexpr uint64_t DEFAULT_LOOP_THRESHOLD = 1000;
 
 class Executor {
 public:
-    bool Run(const Code& code, var& ret);
+    explicit Executor(size_t stackSize = DEFAULT_STACK_SIZE, size_t frameSize = DEFAULT_FRAME_SIZE) :
+        stackSize_{ stackSize }, frameSize_{ frameSize } {
+    }
+
+    // tracer is not owned, nullptr or TraceLevel::OFF runs without any tracing code
+    inline void SetTracer(Tracer* tracer) {
+        tracer_ = tracer;
+    }
+
+    // debug mode, force the checked handlers with UNINIT tracking even if the program is verified
+    inline void SetChecked(bool checked) {
+        checked_ = checked;
+    }
+
+    // translate verified program to register code and run it, checked mode keeps the stack code.
+    // Register code only counts dispatches for tracer, calls and instructions are not traced.
+    inline void SetRegister(bool reg) {
+        register_ = reg;
+    }
+
+    // compile verified program to machine code, it runs without tracing.
+    // The interpreters run what JIT does not support.
+    inline void SetJit(bool jit) {
+        jit_ = jit;
+    }
+
+    // compile verified program to C++ and a shared object by the system compiler, it runs
+    // without tracing. dir keeps the sources and objects, a program is built once.
+    inline void SetAot(bool aot, const std::string& dir = "") {
+        aot_ = aot;
+        compiled_.SetDir(dir);
+    }
+
+    // Tiered execution of verified program: calls of each function and iterations of each loop
+    // are counted, a hot function is called in register code, and a hot loop of a running frame
+    // continues in register code at its head (OSR). Promotions are reported to std::cerr.
+    inline void SetTiering(bool tiered, uint64_t callThreshold = DEFAULT_CALL_THRESHOLD,
+        uint64_t loopThreshold = DEFAULT_LOOP_THRESHOLD) {
+        tiered_ = tiered;
+        callThreshold_ = callThreshold;
+        loopThreshold_ = loopThreshold;
+    }
+
+    // Tracing JIT of hot loops: a loop whose head is jumped to loopThreshold times is recorded
+    // for an iteration and compiled to machine code, which runs until a branch goes
+    // another way than recorded. Loops which cannot be traced are left to tiering, if it is on.
+    inline void SetTraceJit(bool tracing) {
+        tracing_ = tracing;
+    }
+
+    bool Run(const Program& program, var& ret);
     inline var GetExit() const {
         return cpu_.exitCode;
     }
 
-    //static bool Add(Cpu& cpu, const Code& code);
-    //static bool Sub(Cpu& cpu, const Code& code);
-    //static bool Mul(Cpu& cpu, const Code& code);
-    //static bool Div(Cpu& cpu, const Code& code);
-    //static bool Mod(Cpu& cpu, const Code& code);
-    //static bool Neg(Cpu& cpu, const Code& code);
-    //static bool Not(Cpu& cpu, const Code& code);
-    //static bool And(Cpu& cpu, const Code& code);
-    //static bool Or(Cpu& cpu, const Code& code);
-    //static bool BitAnd(Cpu& cpu, const Code& code);
-    //static bool BitOr(Cpu& cpu, const Code& code);
-    //static bool BitXor(Cpu& cpu, const Code& code);
-    //static bool CmpEq(Cpu& cpu, const Code& code);
-    //static bool CmpNe(Cpu& cpu, const Code& code);
-    //static bool CmpGt(Cpu& cpu, const Code& code);
-    //static bool CmpLt(Cpu& cpu, const Code& code);
-    //static bool CmpGe(Cpu& cpu, const Code& code);
-    //static bool CmpLe(Cpu& cpu, const Code& code);
-    //static bool Push(Cpu& cpu, const Code& code);
-    //static bool Pop(Cpu& cpu, const Code& code);
-    //static bool Jmp(Cpu& cpu, const Code& code);
-    //static bool Jz(Cpu& cpu, const Code& code);
-    //static bool Var(Cpu& cpu, const Code& code);
-    //static bool Call(Cpu& cpu, const Code& code);
-    //static bool Ret(Cpu& cpu, const Code& code);
-    //static bool Exit(Cpu& cpu, const Code& code);
-
-    //static inline std::map<InstructionType, std::function<bool(Cpu& cpu, const Code& code)>> instructionOpts = {
-    //    { InstructionType::ADD, Add },
-    //    { InstructionType::SUB, Sub },
-    //    { InstructionType::MUL, Mul },
-    //    { InstructionType::DIV, Div },
-    //    { InstructionType::MOD, Mod },
-    //    { InstructionType::NEG, Neg },
-    //    { InstructionType::NOT, Not },
-    //    { InstructionType::AND, And },
-    //    { InstructionType::OR, Or },
-    //    { InstructionType::BITAND, BitAnd },
-    //    { InstructionType::BITOR, BitOr },
-    //    { InstructionType::BITXOR, BitXor },
-    //    { InstructionType::CMPEQ, CmpEq },
-    //    { InstructionType::CMPNE, CmpNe },
-    //    { InstructionType::CMPGT, CmpGt },
-    //    { InstructionType::CMPLT, CmpLt },
-    //    { InstructionType::CMPGE, CmpGe },
-    //    { InstructionType::CMPLE, CmpLe },
-    //    { InstructionType::PUSH, Push },
-    //    { InstructionType::POP, Pop },
-    //    { InstructionType::JMP, Jmp },
-    //    { InstructionType::JZ, Jz },
-    //    { InstructionType::VAR, Var },
-    //    { InstructionType::CALL, Call },
-    //    { InstructionType::RET, Ret },
-    //    { InstructionType::EXIT, Exit },
-    //};
-
 private:
+    // operands are checked once before running, so handlers need not to
+    bool Check(const Program& program);
+    template <bool kTrace, bool kChecked, bool kTier>
+    bool Exec(const Program& program, var& ret);
+
+    // register code is translated at the first promotion
+    bool Tier(const Program& program);
+    bool Promote(const Program& program, uint32_t funcIdx);
+    // a loop enters register code only at its head with empty stack
+    bool Osr(const Program& program, uint64_t ip, uint32_t funcIdx, uint64_t depth);
+    // a trace is recorded at its head with empty stack, once
+    bool Trace(const Program& program, uint64_t ip, uint32_t funcIdx, uint64_t depth, const var* bp);
+
+    enum class TierState {
+        UNTRIED,
+        READY,
+        FAILED
+    };
+
     Cpu cpu_;
+    size_t stackSize_;
+    size_t frameSize_;
+    Tracer* tracer_{ nullptr };
+    bool checked_{ false };
+    bool register_{ false };
+    RegVm regVm_;
+    bool jit_{ false };
+    Jit native_;
+    bool aot_{ false };
+    Aot compiled_;
+
+    bool tiered_{ false };
+    uint64_t callThreshold_{ DEFAULT_CALL_THRESHOLD };
+    uint64_t loopThreshold_{ DEFAULT_LOOP_THRESHOLD };
+    TierState tierState_{ TierState::UNTRIED };
+    // calls of each function, and backward jumps to each ip
+    std::vector<uint64_t> calls_;
+    std::vector<uint64_t> loops_;
+    bool tracing_{ false };
+    TraceJit traceJit_;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+/**
+ * @file fuser.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "fuser.h"
+
+#include <limits>
+
+static bool IsJump(OpCode op) {
+    return op == OpCode::JMP || op == OpCode::JZ || (op >= OpCode::JZEQLI && op <= OpCode::JZLELI);
+}
+
+// slots in c of superinstructions are 16 bits
+static bool IsShortSlot(uint32_t slot) {
+    return slot <= std::numeric_limits<uint16_t>::max();
+}
+
+void Fuser::Fuse(Program& program) {
+    auto& code = program.code;
+    if (code.empty()) {
+        return;
+    }
+    // the jz before threading, fusing and inverting
+    std::map<uint64_t, std::pair<uint64_t, bool>> sources;
+    for (size_t ip = 0; ip < code.size(); ip++) {
+        if (code[ip].op == OpCode::JZ) {
+            sources[ip] = { code[ip].a, false };
+        }
+    }
+    Thread(program);
+
+    // a sequence must not cover a jump target, an entry or a label except at its head
+    targets_.assign(code.size() + 1, false);
+    for (const auto& bc : code) {
+        if (IsJump(bc.op)) {
+            targets_[bc.a] = true;
+        }
+    }
+    for (const auto& func : program.funcs) {
+        targets_[func.entry] = true;
+        targets_[func.end] = true;
+    }
+    for (const auto& it : program.labels) {
+        targets_[it.first] = true;
+    }
+    targets_[code.size() - 1] = true;
+
+    std::vector<ByteCode> fused;
+    std::vector<uint64_t> indexes(code.size() + 1, 0);
+    fused.reserve(code.size());
+    for (size_t ip = 0; ip < code.size();) {
+        ByteCode bc = code[ip];
+        size_t n = Match(program, ip, bc);
+        n = n == 0 ? 1 : n;
+        for (size_t i = ip; i < ip + n; i++) {
+            indexes[i] = fused.size();
+        }
+        fused.push_back(bc);
+        ip += n;
+    }
+    indexes[code.size()] = fused.size();
+
+    for (auto& bc : fused) {
+        if (IsJump(bc.op)) {
+            bc.a = static_cast<uint32_t>(indexes[bc.a]);
+        }
+    }
+    for (auto& func : program.funcs) {
+        func.entry = indexes[func.entry];
+        func.end = indexes[func.end];
+    }
+    std::map<uint64_t, std::string> labels;
+    for (const auto& it : program.labels) {
+        labels[indexes[it.first]] = it.second;
+    }
+    program.labels.swap(labels);
+    code.swap(fused);
+    // a fused jz is at the head of its sequence, and a target is never inside one
+    program.sources.clear();
+    for (const auto& it : sources) {
+        program.sources[indexes[it.first]] = { indexes[it.second.first], it.second.second };
+    }
+
+    Invert(program);
+}
+
+void Fuser::Thread(Program& program) {
+    auto& code = program.code;
+    for (auto& bc : code) {
+        if (bc.op != OpCode::JMP && bc.op != OpCode::JZ) {
+            continue;
+        }
+        // bounded, a loop of jmps has no last target
+        for (size_t hops = 0; hops < code.size() && code[bc.a].op == OpCode::JMP; hops++) {
+            bc.a = code[bc.a].a;
+        }
+    }
+}
+
+size_t Fuser::Match(const Program& program, size_t ip, ByteCode& fused) {
+    const auto& code = program.code;
+    auto at = [&](size_t i) -> const ByteCode* {
+        // the rest of a sequence is entered only from its head
+        if (ip + i >= code.size() || targets_[ip + i]) {
+            return nullptr;
+        }
+        return &code[ip + i];
+    };
+    const ByteCode& first = code[ip];
+    const ByteCode* second = at(1);
+    const ByteCode* third = at(2);
+    const ByteCode* fourth = third == nullptr ? nullptr : at(3);
+    if (second == nullptr) {
+        return 0;
+    }
+
+    if (first.op == OpCode::PUSHL && second->op == OpCode::PUSHI && third != nullptr && fourth != nullptr) {
+        // push x; push k; add|sub; pop x
+        if ((third->op == OpCode::ADD || third->op == OpCode::SUB) &&
+            fourth->op == OpCode::POPL && fourth->a == first.a &&
+            (third->op == OpCode::ADD || second->b != std::numeric_limits<var>::min())) {
+            fused = { OpCode::INCL, 0, first.a, third->op == OpCode::ADD ? second->b : -second->b };
+            return 4;
+        }
+        // push x; push k; cmpxx; jz
+        if (third->op >= OpCode::CMPEQ && third->op <= OpCode::CMPLE && fourth->op == OpCode::JZ &&
+            IsShortSlot(first.a)) {
+            auto op = static_cast<OpCode>(static_cast<int>(OpCode::JZEQLI) +
+                static_cast<int>(third->op) - static_cast<int>(OpCode::CMPEQ));
+            fused = { op, static_cast<uint16_t>(first.a), fourth->a, second->b };
+            return 4;
+        }
+    }
+
+    if (first.op == OpCode::PUSHL && second->op == OpCode::POPL && IsShortSlot(first.a)) {
+        fused = { OpCode::MOVL, static_cast<uint16_t>(first.a), second->a, 0LL };
+        return 2;
+    }
+    if (first.op == OpCode::PUSHI && second->op == OpCode::POPL) {
+        fused = { OpCode::MOVI, 0, second->a, first.b };
+        return 2;
+    }
+    if (first.op == OpCode::PUSHI) {
+        OpCode op = OpCode::NIL;
+        switch (second->op) {
+        case OpCode::ADD: op = OpCode::ADDI; break;
+        case OpCode::SUB: op = OpCode::SUBI; break;
+        case OpCode::MUL: op = OpCode::MULI; break;
+        // divided by zero or -1 is left to the original handlers, which check it
+        case OpCode::DIV: op = first.b != 0LL && first.b != -1LL ? OpCode::DIVI : OpCode::NIL; break;
+        case OpCode::MOD: op = first.b != 0LL && first.b != -1LL ? OpCode::MODI : OpCode::NIL; break;
+        default: break;
+        }
+        if (op != OpCode::NIL) {
+            fused = { op, 0, 0, first.b };
+            return 2;
+        }
+    }
+    if (first.op == OpCode::PUSHL && second->op == OpCode::PUSHL && IsShortSlot(second->a)) {
+        fused = { OpCode::PUSHLL, static_cast<uint16_t>(second->a), first.a, 0LL };
+        return 2;
+    }
+    return 0;
+}
+
+void Fuser::Invert(Program& program) {
+    auto& code = program.code;
+    for (size_t ip = 0; ip < code.size(); ip++) {
+        auto& bc = code[ip];
+        if (bc.op != OpCode::JMP) {
+            continue;
+        }
+        const auto& head = code[bc.a];
+        if (head.op < OpCode::JZEQLI || head.op > OpCode::JZLELI || head.a != ip + 1) {
+            continue;
+        }
+        // the loop continues when the condition is true, otherwise falls to the exit
+        OpCode op = OpCode::NIL;
+        switch (head.op) {
+        case OpCode::JZEQLI: op = OpCode::JZNELI; break;
+        case OpCode::JZNELI: op = OpCode::JZEQLI; break;
+        case OpCode::JZGTLI: op = OpCode::JZLELI; break;
+        case OpCode::JZLTLI: op = OpCode::JZGELI; break;
+        case OpCode::JZGELI: op = OpCode::JZLTLI; break;
+        default: op = OpCode::JZGTLI; break;
+        }
+        auto source = program.sources.find(bc.a);
+        if (source != program.sources.end()) {
+            program.sources[ip] = { source->second.first, !source->second.second };
+        }
+        bc = { op, head.c, bc.a + 1, head.b };
+    }
+}
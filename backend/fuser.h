@@ -0,0 +1,36 @@
+/**
+ * @file fuser.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef FUSER_H
+#define FUSER_H
+
+#include "instruction.h"
+
+// Rewrites the common sequences of bytecode into superinstructions.
+// The patterns are chosen by the opcode pairs counted with --stats:
+// pushl->pushi, pushi->cmpxx->jz, pushi->add/sub/mod and add->popl lead the loops.
+// A sequence is fused only when no jump lands inside it, so verified states still hold.
+class Fuser {
+public:
+    void Fuse(Program& program);
+
+private:
+    // jmp to jmp, and jz to jmp, go to the last target directly
+    void Thread(Program& program);
+    // size of the sequence fused at ip, 0 if no pattern matches
+    size_t Match(const Program& program, size_t ip, ByteCode& fused);
+    // jmp back to a jzxxli, which exits to the next of jmp, becomes the inverted jzxxli
+    void Invert(Program& program);
+
+    std::vector<bool> targets_;
+};
+
+#endif
@@ -13,7 +13,9 @@
 #define INSTRUCTION_H
 
 #include <array>
-#include <functional>
+#include <climits>
+#include <cstdint>
+#include <iostream>
 #include <string>
 #include <map>
 #include <vector>
@@ -47,6 +49,12 @@ enum class InstructionType : int {
     CALL,
     RET,
     EXIT,
+    // internal: call f; ret ~ of a function, found by Optimizer
+    TAILCALL,
+    // internal: mul, div and mod by 2^k of Optimizer, argument is k
+    SHL,
+    SHR,
+    MASK,
     MAX
 };
 
@@ -58,66 +66,191 @@ struct IntermediateRepresentation {
 
 using var = long long;
 
+// runs of a jz of a profile, which jumped or fell through
+struct BranchCount {
+    uint64_t taken;
+    uint64_t fallen;
+};
+
 struct Code {
     void Clear() {
         irs.clear();
         labelMap.clear();
         funcMap.clear();
+        branches.clear();
     }
 
     void Print();
     std::vector<IntermediateRepresentation> irs;
     std::map<const std::string, uint64_t> labelMap;
     std::map<const std::string, uint64_t> funcMap;
+    // jz of earlier runs by the label jumped to, blocks are laid out by them
+    std::map<std::string, BranchCount> branches;
 };
 
 enum class StackItemType : int {
     UNINIT = 0,
     CONST,
-    VAR,
-    ARG_SIZE,
-    IP,
-    VAR_MAP
+    VAR
 };
 
 inline std::map<StackItemType, const char* const> statckItemStrMap = {
     { StackItemType::UNINIT, "UNINIT" },
     { StackItemType::CONST, "CONST" },
-    { StackItemType::VAR, "VAR" },
-    { StackItemType::ARG_SIZE, "ARG_SIZE" },
-    { StackItemType::IP, "IP" },
-    { StackItemType::VAR_MAP, "VAR_MAP" }
+    { StackItemType::VAR, "VAR" }
 };
 
-struct StackItem {
-    StackItemType type;
-    var data;
+// Labels as values of GCC/Clang: every handler jumps to the next handler directly.
+// Other compilers fall back to a switch in a loop, or define HYS_COMPUTED_GOTO=0 to force it.
+#ifndef HYS_COMPUTED_GOTO
+#if defined(__GNUC__) || defined(__clang__)
+#define HYS_COMPUTED_GOTO 1
+#else
+#define HYS_COMPUTED_GOTO 0
+#endif
+#endif
+
+// Binary form of the IRs, emitted by Assembler::Encode.
+// Operands are resolved at load time: immediates are decoded,
+// jump targets are absolute indices and variables are frame slots.
+enum class OpCode : uint8_t {
+    NIL = 0x0,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    NEG,
+    NOT,
+    AND,
+    OR,
+    BITAND,
+    BITOR,
+    BITXOR,
+    CMPEQ,
+    CMPNE,
+    CMPGT,
+    CMPLT,
+    CMPGE,
+    CMPLE,
+    PUSHI,  // push imm:              b = value
+    PUSHL,  // push local:            a = slot
+    POPL,   // pop to local:          a = slot
+    POP,    // pop and discard
+    JMP,    // a = target ip
+    JZ,     // a = target ip, always pops the condition
+    CALL,   // a = index of Program::funcs
+    TAILCALL, // call a in place of the current frame, callee returns to the caller of it
+    RET,    // return stack top
+    RETV,   // return without value
+    EXIT,   // exit with stack top
+    EXITV,  // exit without value
+    HALT,   // end of code, appended by assembler
+
+    // superinstructions, fused from the common sequences by Fuser
+    INCL,   // push x; push k; add; pop x:      a = slot, b = k
+    MOVL,   // push y; pop x:                   a = slot of x, c = slot of y
+    MOVI,   // push k; pop x:                   a = slot, b = k
+    PUSHLL, // push x; push y:                  a = slot of x, c = slot of y
+    ADDI,   // push k; add:                     b = k
+    SUBI,   // push k; sub:                     b = k
+    MULI,   // push k; mul:                     b = k
+    DIVI,   // push k; div, k is not 0:         b = k
+    MODI,   // push k; mod, k is not 0:         b = k
+    SHLI,   // shl k, x * 2^k:                  b = k
+    SHRI,   // shr k, x / 2^k:                  b = k
+    MASKI,  // mask k, x % 2^k:                 b = k
+    JZEQLI, // push x; push k; cmpeq; jz:       a = target ip, b = k, c = slot
+    JZNELI, // push x; push k; cmpne; jz
+    JZGTLI, // push x; push k; cmpgt; jz
+    JZLTLI, // push x; push k; cmplt; jz
+    JZGELI, // push x; push k; cmpge; jz
+    JZLELI, // push x; push k; cmple; jz
+    MAX
 };
 
-struct Cpu {
-    Cpu() : varMap{ new std::map<const std::string, var> } {
-    }
-    ~Cpu() {
-        Clear();
-        if (varMap != nullptr) {
-            delete varMap;
-        }
+struct ByteCode {
+    OpCode op;
+    // second slot of superinstructions, it fills the padding after op
+    uint16_t c;
+    uint32_t a;
+    var b;
+};
+static_assert(sizeof(ByteCode) == 16);
+
+struct FuncInfo {
+    std::string name;
+    uint64_t entry;
+    // end of code of function, exclusive
+    uint64_t end;
+    uint32_t argc;
+    uint32_t varc;
+    // slot names, args first and then locals, just for printing
+    std::vector<std::string> slots;
+    // max depth of operands above locals, proved by verifier
+    uint32_t maxStack{ 0 };
+};
+
+struct Program {
+    void Clear() {
+        code.clear();
+        funcs.clear();
+        labels.clear();
+        sources.clear();
+        verified = false;
     }
 
+    void Print();
+    std::vector<ByteCode> code;
+    // funcs[0] is the top level code before the first FUNC
+    std::vector<FuncInfo> funcs;
+    std::map<uint64_t, std::string> labels;
+    // conditional jumps of the fuser by ip: the target of the jz it comes from, and whether it
+    // jumps where that jz falls through. A profile of branches is named by the jz encoded
+    std::map<uint64_t, std::pair<uint64_t, bool>> sources;
+    // set by verifier, verified code runs without runtime checks
+    bool verified{ false };
+};
+
+// Frame of callee on stack: [args][locals][operands]
+// slot i of a function is the i-th item from frame base, sized once by its header.
+// Caller's info is kept in the control stack, not in the operand stack.
+struct Frame {
+    // ip of the call instruction
+    uint64_t ip;
+    // caller's frame base
+    uint64_t bp;
+    // index of callee in Program::funcs
+    uint32_t func;
+};
+
+struct Cpu {
     inline void Clear() {
-        if (varMap != nullptr) {
-            varMap->clear();
-        }
         ip = 0;
+        sp = 0;
+        bp = 0;
+        fp = 0;
         stack.clear();
+        tags.clear();
+        frames.clear();
+        exit = false;
         exitCode = 0LL;
     }
 
-    void Print();
+    void Print(std::ostream& out = std::cout) const;
 
-    std::map<const std::string, var>* varMap;
     uint64_t ip{ 0ULL };
-    std::vector<StackItem> stack;
+    // count of used stack items, stack is sized to the capacity by executor
+    uint64_t sp{ 0ULL };
+    // frame base, index of the first arg of current function
+    uint64_t bp{ 0ULL };
+    // frame pointer, count of active frames in control stack
+    uint64_t fp{ 0ULL };
+    // plain values of operand stack
+    std::vector<var> stack;
+    // UNINIT tracking of stack items, only kept in checked mode
+    std::vector<StackItemType> tags;
+    std::vector<Frame> frames;
     bool exit{ false };
     var exitCode{ 0LL };
 };
@@ -125,68 +258,144 @@ struct Cpu {
 struct InstructionInfo {
     InstructionType type;
     const char* const str;
-    std::function<bool(Cpu& cpu, const Code& code)> func;
-};
-
-bool Add(Cpu& cpu, const Code& code);
-bool Sub(Cpu& cpu, const Code& code);
-bool Mul(Cpu& cpu, const Code& code);
-bool Div(Cpu& cpu, const Code& code);
-bool Mod(Cpu& cpu, const Code& code);
-bool Neg(Cpu& cpu, const Code& code);
-bool Not(Cpu& cpu, const Code& code);
-bool And(Cpu& cpu, const Code& code);
-bool Or(Cpu& cpu, const Code& code);
-bool BitAnd(Cpu& cpu, const Code& code);
-bool BitOr(Cpu& cpu, const Code& code);
-bool BitXor(Cpu& cpu, const Code& code);
-bool CmpEq(Cpu& cpu, const Code& code);
-bool CmpNe(Cpu& cpu, const Code& code);
-bool CmpGt(Cpu& cpu, const Code& code);
-bool CmpLt(Cpu& cpu, const Code& code);
-bool CmpGe(Cpu& cpu, const Code& code);
-bool CmpLe(Cpu& cpu, const Code& code);
-bool Push(Cpu& cpu, const Code& code);
-bool Pop(Cpu& cpu, const Code& code);
-bool Jmp(Cpu& cpu, const Code& code);
-bool Jz(Cpu& cpu, const Code& code);
-bool Var(Cpu& cpu, const Code& code);
-bool Call(Cpu& cpu, const Code& code);
-bool Ret(Cpu& cpu, const Code& code);
-bool Exit(Cpu& cpu, const Code& code);
+};
 
 // Do not use MAX as item, just as array size.
 inline const std::array<InstructionInfo, static_cast<size_t>(InstructionType::MAX)> instructionInfos = {
-    InstructionInfo{ InstructionType::NIL, "", nullptr },
-    InstructionInfo{ InstructionType::ADD, "add", Add },
-    InstructionInfo{ InstructionType::SUB, "sub", Sub },
-    InstructionInfo{ InstructionType::MUL, "mul", Mul },
-    InstructionInfo{ InstructionType::DIV, "div", Div },
-    InstructionInfo{ InstructionType::MOD, "mod", Mod },
-    InstructionInfo{ InstructionType::NEG, "neg", Neg },
-    InstructionInfo{ InstructionType::NOT, "not", Not },
-    InstructionInfo{ InstructionType::AND, "and", And },
-    InstructionInfo{ InstructionType::OR, "or", Or },
-    InstructionInfo{ InstructionType::BITAND, "bitand", BitAnd },
-    InstructionInfo{ InstructionType::BITOR, "bitor", BitOr },
-    InstructionInfo{ InstructionType::BITXOR, "bitxor", BitXor },
-    InstructionInfo{ InstructionType::CMPEQ, "cmpeq", CmpEq },
-    InstructionInfo{ InstructionType::CMPNE, "cmpne", CmpNe },
-    InstructionInfo{ InstructionType::CMPGT, "cmpgt", CmpGt },
-    InstructionInfo{ InstructionType::CMPLT, "cmplt", CmpLt },
-    InstructionInfo{ InstructionType::CMPGE, "cmpge", CmpGe},
-    InstructionInfo{ InstructionType::CMPLE, "cmple", CmpLe },
-    InstructionInfo{ InstructionType::PUSH, "push", Push },
-    InstructionInfo{ InstructionType::POP, "pop", Pop },
-    InstructionInfo{ InstructionType::JMP, "jmp", Jmp },
-    InstructionInfo{ InstructionType::JZ, "jz", Jz },
-    InstructionInfo{ InstructionType::ARG, "arg", nullptr },
-    InstructionInfo{ InstructionType::VAR, "var", Var },
-    InstructionInfo{ InstructionType::CALL, "call", Call },
-    InstructionInfo{ InstructionType::RET, "ret", Ret },
-    InstructionInfo{ InstructionType::EXIT, "exit", Exit }
+    InstructionInfo{ InstructionType::NIL, "" },
+    InstructionInfo{ InstructionType::ADD, "add" },
+    InstructionInfo{ InstructionType::SUB, "sub" },
+    InstructionInfo{ InstructionType::MUL, "mul" },
+    InstructionInfo{ InstructionType::DIV, "div" },
+    InstructionInfo{ InstructionType::MOD, "mod" },
+    InstructionInfo{ InstructionType::NEG, "neg" },
+    InstructionInfo{ InstructionType::NOT, "not" },
+    InstructionInfo{ InstructionType::AND, "and" },
+    InstructionInfo{ InstructionType::OR, "or" },
+    InstructionInfo{ InstructionType::BITAND, "bitand" },
+    InstructionInfo{ InstructionType::BITOR, "bitor" },
+    InstructionInfo{ InstructionType::BITXOR, "bitxor" },
+    InstructionInfo{ InstructionType::CMPEQ, "cmpeq" },
+    InstructionInfo{ InstructionType::CMPNE, "cmpne" },
+    InstructionInfo{ InstructionType::CMPGT, "cmpgt" },
+    InstructionInfo{ InstructionType::CMPLT, "cmplt" },
+    InstructionInfo{ InstructionType::CMPGE, "cmpge"},
+    InstructionInfo{ InstructionType::CMPLE, "cmple" },
+    InstructionInfo{ InstructionType::PUSH, "push" },
+    InstructionInfo{ InstructionType::POP, "pop" },
+    InstructionInfo{ InstructionType::JMP, "jmp" },
+    InstructionInfo{ InstructionType::JZ, "jz" },
+    InstructionInfo{ InstructionType::ARG, "arg" },
+    InstructionInfo{ InstructionType::VAR, "var" },
+    InstructionInfo{ InstructionType::CALL, "call" },
+    InstructionInfo{ InstructionType::RET, "ret" },
+    InstructionInfo{ InstructionType::EXIT, "exit" },
+    InstructionInfo{ InstructionType::TAILCALL, "tailcall" },
+    InstructionInfo{ InstructionType::SHL, "shl" },
+    InstructionInfo{ InstructionType::SHR, "shr" },
+    InstructionInfo{ InstructionType::MASK, "mask" }
 };
 
+struct OpCodeInfo {
+    OpCode op;
+    const char* const str;
+};
+
+// quotient of LLONG_MIN by -1 overflows, div and mod of it trap on the machine as by zero
+inline bool IsOverflow(var left, var right) {
+    return left == LLONG_MIN && right == -1LL;
+}
+
+// Do not use MAX as item, just as array size.
+inline const std::array<OpCodeInfo, static_cast<size_t>(OpCode::MAX)> opCodeInfos = {
+    OpCodeInfo{ OpCode::NIL, "" },
+    OpCodeInfo{ OpCode::ADD, "add" },
+    OpCodeInfo{ OpCode::SUB, "sub" },
+    OpCodeInfo{ OpCode::MUL, "mul" },
+    OpCodeInfo{ OpCode::DIV, "div" },
+    OpCodeInfo{ OpCode::MOD, "mod" },
+    OpCodeInfo{ OpCode::NEG, "neg" },
+    OpCodeInfo{ OpCode::NOT, "not" },
+    OpCodeInfo{ OpCode::AND, "and" },
+    OpCodeInfo{ OpCode::OR, "or" },
+    OpCodeInfo{ OpCode::BITAND, "bitand" },
+    OpCodeInfo{ OpCode::BITOR, "bitor" },
+    OpCodeInfo{ OpCode::BITXOR, "bitxor" },
+    OpCodeInfo{ OpCode::CMPEQ, "cmpeq" },
+    OpCodeInfo{ OpCode::CMPNE, "cmpne" },
+    OpCodeInfo{ OpCode::CMPGT, "cmpgt" },
+    OpCodeInfo{ OpCode::CMPLT, "cmplt" },
+    OpCodeInfo{ OpCode::CMPGE, "cmpge" },
+    OpCodeInfo{ OpCode::CMPLE, "cmple" },
+    OpCodeInfo{ OpCode::PUSHI, "pushi" },
+    OpCodeInfo{ OpCode::PUSHL, "pushl" },
+    OpCodeInfo{ OpCode::POPL, "popl" },
+    OpCodeInfo{ OpCode::POP, "pop" },
+    OpCodeInfo{ OpCode::JMP, "jmp" },
+    OpCodeInfo{ OpCode::JZ, "jz" },
+    OpCodeInfo{ OpCode::CALL, "call" },
+    OpCodeInfo{ OpCode::TAILCALL, "tailcall" },
+    OpCodeInfo{ OpCode::RET, "ret" },
+    OpCodeInfo{ OpCode::RETV, "retv" },
+    OpCodeInfo{ OpCode::EXIT, "exit" },
+    OpCodeInfo{ OpCode::EXITV, "exitv" },
+    OpCodeInfo{ OpCode::HALT, "halt" },
+    OpCodeInfo{ OpCode::INCL, "incl" },
+    OpCodeInfo{ OpCode::MOVL, "movl" },
+    OpCodeInfo{ OpCode::MOVI, "movi" },
+    OpCodeInfo{ OpCode::PUSHLL, "pushll" },
+    OpCodeInfo{ OpCode::ADDI, "addi" },
+    OpCodeInfo{ OpCode::SUBI, "subi" },
+    OpCodeInfo{ OpCode::MULI, "muli" },
+    OpCodeInfo{ OpCode::DIVI, "divi" },
+    OpCodeInfo{ OpCode::MODI, "modi" },
+    OpCodeInfo{ OpCode::SHLI, "shli" },
+    OpCodeInfo{ OpCode::SHRI, "shri" },
+    OpCodeInfo{ OpCode::MASKI, "maski" },
+    OpCodeInfo{ OpCode::JZEQLI, "jzeqli" },
+    OpCodeInfo{ OpCode::JZNELI, "jzneli" },
+    OpCodeInfo{ OpCode::JZGTLI, "jzgtli" },
+    OpCodeInfo{ OpCode::JZLTLI, "jzltli" },
+    OpCodeInfo{ OpCode::JZGELI, "jzgeli" },
+    OpCodeInfo{ OpCode::JZLELI, "jzleli" }
+};
+
+// add, sub and mul wrap on signed overflow through uint64_t, as the machine code does
+inline var WrapAdd(var left, var right) {
+    return static_cast<var>(static_cast<uint64_t>(left) + static_cast<uint64_t>(right));
+}
+
+inline var WrapSub(var left, var right) {
+    return static_cast<var>(static_cast<uint64_t>(left) - static_cast<uint64_t>(right));
+}
+
+inline var WrapMul(var left, var right) {
+    return static_cast<var>(static_cast<uint64_t>(left) * static_cast<uint64_t>(right));
+}
+
+// bits of shli, shri and maski are 1 ~ MAX_SHIFT, so 2^k is a positive var
+constexpr var MAX_SHIFT = 62;
+
+inline var ShiftLeft(var value, var bits) {
+    return static_cast<var>(static_cast<uint64_t>(value) << bits);
+}
+
+// a negative value is biased by 2^k - 1, so the shift rounds toward zero as div does
+inline var ShiftRight(var value, var bits) {
+    var bias = (value >> 63) & ((1LL << bits) - 1);
+    return (value + bias) >> bits;
+}
+
+// remainder of ShiftRight, which has the sign of value as mod does
+inline var Mask(var value, var bits) {
+    var bias = (value >> 63) & ((1LL << bits) - 1);
+    return ((value + bias) & ((1LL << bits) - 1)) - bias;
+}
+
+// value of a binary arithmetic op, signed overflow wraps as the machine code does.
+// shli, shri and maski take the bits as right. The divisor is checked by caller
+var Evaluate(OpCode op, var left, var right);
+
 InstructionType GetInstructionType(const std::string& instructionStr);
 
 bool IsIdentifier(const std::string& ident);
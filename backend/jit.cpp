@@ -0,0 +1,449 @@
+/**
+ * @file jit.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "jit.h"
+
+#include <cstddef>
+#include <iostream>
+
+#if HYS_JIT
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// the bytes of Leave, it is skipped by a short jump
+constexpr uint8_t LEAVE_SIZE = 15;
+
+inline int32_t Slot(uint32_t slot) {
+	return static_cast<int32_t>(slot) * static_cast<int32_t>(sizeof(var));
+}
+
+} // namespace
+
+Jit::~Jit() {
+	Release();
+#if HYS_JIT
+	if (stack_ != nullptr) {
+		munmap(stack_, stackSize_);
+	}
+#endif
+}
+
+void Jit::Release() {
+	Uninstall(code_, size_);
+	code_ = nullptr;
+	size_ = 0;
+}
+
+void Jit::Leave(Status status, uint64_t ip) {
+	// mov edx, ip; mov eax, status; jmp exit
+	Byte(0xBA);
+	Int32(static_cast<int32_t>(ip));
+	Byte(0xB8);
+	Int32(status);
+	Byte(0xE9);
+	Int32(static_cast<int32_t>(exitStub_ - (buf_.size() + 4)));
+}
+
+bool Jit::Compile(const Program& program) {
+	Release();
+#if !HYS_JIT
+	(void)program;
+	std::cerr << "[warn]: JIT does not support the target." << std::endl;
+	return false;
+#else
+	if (!program.verified || program.funcs.empty()) {
+		std::cerr << "[warn]: JIT needs a verified program." << std::endl;
+		return false;
+	}
+	const auto& code = program.code;
+	buf_.clear();
+	natives_.assign(code.size(), SIZE_MAX);
+	entries_.assign(program.funcs.size(), SIZE_MAX);
+	tailEntries_.assign(program.funcs.size(), SIZE_MAX);
+	jumps_.clear();
+	calls_.clear();
+	tailCalls_.clear();
+	varc_ = program.funcs[0].varc;
+
+	// int32_t entry(Context* ctx): keep callee-saved registers, switch to the stack of JIT
+	for (int reg : { RBX, RBP, R12, R13, R14, R15 }) {
+		Push(reg);
+	}
+	Reg({ 0x89 }, RDI, R13);
+	Mem({ 0x89 }, RSP, R13, offsetof(Context, savedRsp));
+	Mem({ 0x8B }, RSP, R13, offsetof(Context, nativeStack));
+	Mem({ 0x8B }, RBX, R13, offsetof(Context, sp));
+	Mem({ 0x8B }, R12, R13, offsetof(Context, bp));
+	Mem({ 0x8B }, R14, R13, offsetof(Context, limit));
+	Mem({ 0x8B }, R15, R13, offsetof(Context, depth));
+	Jump({ 0xE9 }, program.funcs[0].entry, jumps_);
+
+	// every way out, status in eax and ip in edx, rsp drops all native frames
+	exitStub_ = buf_.size();
+	Mem({ 0x89 }, RBX, R13, offsetof(Context, sp));
+	Mem({ 0x89 }, RDX, R13, offsetof(Context, ip));
+	Mem({ 0x8B }, RSP, R13, offsetof(Context, savedRsp));
+	for (int reg : { R15, R14, R13, R12, RBP, RBX }) {
+		Pop(reg);
+	}
+	Byte(0xC3);
+
+	for (uint32_t f = 0; f < program.funcs.size(); f++) {
+		const auto& func = program.funcs[f];
+		entries_[f] = buf_.size();
+		if (f > 0) {
+			Prologue(func, tailEntries_[f]);
+		}
+		for (uint64_t ip = func.entry; ip < func.end; ip++) {
+			natives_[ip] = buf_.size();
+			if (!Template(program, f, ip)) {
+				std::cerr << "[warn]: JIT does not support " <<
+					opCodeInfos[static_cast<size_t>(code[ip].op)].str << "." << std::endl;
+				return false;
+			}
+		}
+		// falling off a function only reaches halt
+		Jump({ 0xE9 }, code.size() - 1, jumps_);
+	}
+	natives_[code.size() - 1] = buf_.size();
+	Leave(OK, code.size() - 1);
+
+	for (const auto& it : jumps_) {
+		if (natives_[it.second] == SIZE_MAX) {
+			std::cerr << "[warn]: JIT jumps out of functions." << std::endl;
+			return false;
+		}
+		Patch(it.first, natives_[it.second]);
+	}
+	for (const auto& it : calls_) {
+		Patch(it.first, entries_[it.second]);
+	}
+	for (const auto& it : tailCalls_) {
+		Patch(it.first, tailEntries_[it.second]);
+	}
+
+	code_ = Install(size_);
+	return code_ != nullptr;
+#endif
+}
+
+// callee's frame as CALL of interpreter: check depth of calls and room of the whole frame,
+// then bp points to args and locals are zeroed. A tail call enters after the native frame is made
+void Jit::Prologue(const FuncInfo& func, size_t& tailEntry) {
+	// test r15, r15; jne ok
+	Reg({ 0x85 }, R15, R15);
+	Byte(0x70 + CC_NE);
+	Byte(LEAVE_SIZE);
+	Leave(OVERFLOW, func.entry);
+	// dec r15; push r12
+	Reg({ 0xFF }, 1, R15);
+	Byte(0x41);
+	Byte(0x54);
+
+	tailEntry = buf_.size();
+	// lea rax, [rbx + frame]; cmp rax, r14; jbe ok
+	Mem({ 0x8D }, RAX, RBX, Slot(func.varc + func.maxStack));
+	Reg({ 0x39 }, R14, RAX);
+	Byte(0x70 + CC_BE);
+	Byte(LEAVE_SIZE);
+	Leave(OVERFLOW, func.entry);
+	// lea r12, [rbx - args]
+	Mem({ 0x8D }, R12, RBX, -Slot(func.argc));
+
+	// xor eax, eax, then store it to locals
+	Byte(0x31);
+	Byte(0xC0);
+	if (func.varc <= 8) {
+		for (uint32_t i = 0; i < func.varc; i++) {
+			Mem({ 0x89 }, RAX, RBX, Slot(i));
+		}
+		if (func.varc > 0) {
+			Reg({ 0x81 }, 0, RBX);
+			Int32(Slot(func.varc));
+		}
+		return;
+	}
+	// mov ecx, varc; loop: mov [rbx], rax; add rbx, 8; dec rcx; jnz loop
+	Byte(0xB9);
+	Int32(static_cast<int32_t>(func.varc));
+	size_t loop = buf_.size();
+	Mem({ 0x89 }, RAX, RBX, 0);
+	Reg({ 0x81 }, 0, RBX);
+	Int32(Slot(1));
+	Reg({ 0xFF }, 1, RCX);
+	Byte(0x70 + CC_NE);
+	Byte(static_cast<uint8_t>(loop - (buf_.size() + 1)));
+}
+
+bool Jit::Operate(OpCode op, uint64_t ip) {
+	if (op == OpCode::DIV || op == OpCode::MOD) {
+		bool mod = op == OpCode::MOD;
+		// test rcx, rcx; jne ok
+		Reg({ 0x85 }, RCX, RCX);
+		Byte(0x70 + CC_NE);
+		Byte(LEAVE_SIZE);
+		Leave(mod ? MOD_BY_ZERO : DIVIDED_BY_ZERO, ip);
+		// cmp rcx, -1; jne ok; mov rdx, rax; neg rdx; jno ok, only the least rax overflows
+		Reg({ 0x83 }, 7, RCX);
+		Byte(0xFF);
+		Byte(0x70 + CC_NE);
+		Byte(static_cast<uint8_t>(3 + 3 + 2 + LEAVE_SIZE));
+		Reg({ 0x89 }, RAX, RDX);
+		Reg({ 0xF7 }, 3, RDX);
+		Byte(0x70 + CC_NO);
+		Byte(LEAVE_SIZE);
+		Leave(mod ? MOD_OVERFLOW : DIV_OVERFLOW, ip);
+	}
+	return Emitter::Operate(op);
+}
+
+bool Jit::Template(const Program& program, uint32_t funcIdx, uint64_t ip) {
+	const auto& bc = program.code[ip];
+	// mov [rbx], rax; add rbx, 8
+	auto push = [this]() {
+		Mem({ 0x89 }, RAX, RBX, 0);
+		Reg({ 0x81 }, 0, RBX);
+		Int32(Slot(1));
+	};
+	// sub rbx, 8
+	auto drop = [this]() {
+		Reg({ 0x81 }, 5, RBX);
+		Int32(Slot(1));
+	};
+	auto load = [this](int reg, uint32_t slot) {
+		Mem({ 0x8B }, reg, R12, Slot(slot));
+	};
+	auto store = [this](int reg, uint32_t slot) {
+		Mem({ 0x89 }, reg, R12, Slot(slot));
+	};
+
+	switch (bc.op) {
+	case OpCode::NEG:
+		// neg qword [rbx - 8]
+		Mem({ 0xF7 }, 3, RBX, -Slot(1));
+		return true;
+	case OpCode::NOT:
+		// test rax, rax; sete al; movzx eax, al
+		Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		Reg({ 0x85 }, RAX, RAX);
+		Byte(0x0F);
+		Byte(0x90 + CC_E);
+		Byte(0xC0);
+		Byte(0x0F);
+		Byte(0xB6);
+		Byte(0xC0);
+		Mem({ 0x89 }, RAX, RBX, -Slot(1));
+		return true;
+	case OpCode::PUSHI:
+		MovImm(RAX, bc.b);
+		push();
+		return true;
+	case OpCode::PUSHL:
+		load(RAX, bc.a);
+		push();
+		return true;
+	case OpCode::PUSHLL:
+		load(RAX, bc.a);
+		push();
+		load(RAX, bc.c);
+		push();
+		return true;
+	case OpCode::POPL:
+		Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		store(RAX, bc.a);
+		drop();
+		return true;
+	case OpCode::POP:
+		drop();
+		return true;
+	case OpCode::JMP:
+		Jump({ 0xE9 }, bc.a, jumps_);
+		return true;
+	case OpCode::JZ:
+		// the condition is consumed, then test rax, rax; je target
+		Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		drop();
+		Reg({ 0x85 }, RAX, RAX);
+		Jump({ 0x0F, 0x80 + CC_E }, bc.a, jumps_);
+		return true;
+	case OpCode::CALL:
+		Jump({ 0xE8 }, bc.a, calls_);
+		return true;
+	case OpCode::TAILCALL: {
+		// args move down to bp, rbx is above them, then jmp to the tail entry of callee
+		uint32_t argc = program.funcs[bc.a].argc;
+		for (uint32_t i = 0; i < argc; i++) {
+			Mem({ 0x8B }, RAX, RBX, -Slot(argc - i));
+			Mem({ 0x89 }, RAX, R12, Slot(i));
+		}
+		Mem({ 0x8D }, RBX, R12, Slot(argc));
+		Jump({ 0xE9 }, bc.a, tailCalls_);
+		return true;
+	}
+	case OpCode::RET:
+	case OpCode::RETV:
+		// the frame is replaced with the return value
+		if (bc.op == OpCode::RET) {
+			Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		} else {
+			Byte(0x31);
+			Byte(0xC0);
+		}
+		Reg({ 0x89 }, R12, RBX);
+		push();
+		if (funcIdx == 0) {
+			Leave(OK, ip);
+			return true;
+		}
+		// pop r12; inc r15; ret
+		Byte(0x41);
+		Byte(0x5C);
+		Reg({ 0xFF }, 0, R15);
+		Byte(0xC3);
+		return true;
+	case OpCode::EXIT:
+	case OpCode::EXITV:
+		if (bc.op == OpCode::EXIT) {
+			Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		} else {
+			Byte(0x31);
+			Byte(0xC0);
+		}
+		Mem({ 0x89 }, RAX, R13, offsetof(Context, exitCode));
+		Leave(EXIT, ip);
+		return true;
+	case OpCode::HALT:
+		Leave(OK, ip);
+		return true;
+	case OpCode::INCL:
+		if (IsInt32(bc.b)) {
+			// add qword [r12 + slot], imm32
+			Mem({ 0x81 }, 0, R12, Slot(bc.a));
+			Int32(static_cast<int32_t>(bc.b));
+		} else {
+			MovImm(RAX, bc.b);
+			Mem({ 0x01 }, RAX, R12, Slot(bc.a));
+		}
+		return true;
+	case OpCode::MOVL:
+		load(RAX, bc.c);
+		store(RAX, bc.a);
+		return true;
+	case OpCode::MOVI:
+		MovImm(RAX, bc.b);
+		store(RAX, bc.a);
+		return true;
+	case OpCode::ADDI:
+	case OpCode::SUBI:
+	case OpCode::MULI:
+	case OpCode::DIVI:
+	case OpCode::MODI: {
+		static const OpCode ops[] = { OpCode::ADD, OpCode::SUB, OpCode::MUL, OpCode::DIV, OpCode::MOD };
+		Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		// the divisor is known, a multiply is much cheaper than idiv
+		bool divide = bc.op == OpCode::DIVI || bc.op == OpCode::MODI;
+		if (!divide || !Divide(bc.op, bc.b)) {
+			MovImm(RCX, bc.b);
+			Operate(ops[static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::ADDI)], ip);
+		}
+		Mem({ 0x89 }, RAX, RBX, -Slot(1));
+		return true;
+	}
+	case OpCode::SHLI:
+	case OpCode::SHRI:
+	case OpCode::MASKI:
+		Mem({ 0x8B }, RAX, RBX, -Slot(1));
+		Shift(bc.op, bc.b);
+		Mem({ 0x89 }, RAX, RBX, -Slot(1));
+		return true;
+	case OpCode::JZEQLI:
+	case OpCode::JZNELI:
+	case OpCode::JZGTLI:
+	case OpCode::JZLTLI:
+	case OpCode::JZGELI:
+	case OpCode::JZLELI:
+		// cmp local, imm; jump if it is false
+		load(RAX, bc.c);
+		MovImm(RCX, bc.b);
+		Reg({ 0x39 }, RCX, RAX);
+		Jump({ 0x0F, static_cast<uint8_t>(0x80 + inverses[static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::JZEQLI)]) },
+			bc.a, jumps_);
+		return true;
+	default:
+		// binary operators: rax = [rbx - 16] op [rbx - 8]
+		Mem({ 0x8B }, RCX, RBX, -Slot(1));
+		Mem({ 0x8B }, RAX, RBX, -Slot(2));
+		if (!Operate(bc.op, ip)) {
+			return false;
+		}
+		Mem({ 0x89 }, RAX, RBX, -Slot(2));
+		drop();
+		return true;
+	}
+}
+
+bool Jit::Run(Cpu& cpu, size_t frameSize, var& ret) {
+#if !HYS_JIT
+	(void)cpu;
+	(void)frameSize;
+	(void)ret;
+	return false;
+#else
+	if (code_ == nullptr) {
+		return false;
+	}
+	// a native frame is the return address and the saved bp
+	size_t stackSize = (frameSize + 1) * 2 * sizeof(void*);
+	if (stackSize_ < stackSize) {
+		if (stack_ != nullptr) {
+			munmap(stack_, stackSize_);
+		}
+		stack_ = mmap(nullptr, stackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (stack_ == MAP_FAILED) {
+			stack_ = nullptr;
+			stackSize_ = 0;
+			std::cerr << "[err]: JIT cannot map stack." << std::endl;
+			return false;
+		}
+		stackSize_ = stackSize;
+	}
+
+	var* stack = cpu.stack.data();
+	Context ctx{ stack + varc_, stack, stack + cpu.stack.size(), frameSize,
+		static_cast<char*>(stack_) + stackSize_, nullptr, 0, 0LL };
+	auto entry = reinterpret_cast<int32_t (*)(Context*)>(code_);
+	int32_t status = entry(&ctx);
+
+	cpu.ip = ctx.ip;
+	cpu.sp = ctx.sp - stack;
+	switch (status) {
+	case OK:
+		break;
+	case EXIT:
+		cpu.exitCode = ctx.exitCode;
+		std::cout << "[EXIT]: " << cpu.exitCode << std::endl;
+		cpu.exit = true;
+		break;
+	default: {
+		static const char* const errs[] = { "", "", "Div: divided by zero.", "Call: stack overflow.",
+			"Mod: divided by zero.", "Div: overflow.", "Mod: overflow." };
+		std::cerr << "[err]: Exec jit " << cpu.ip << " failed: " << errs[status] << std::endl;
+		return false;
+	}
+	}
+	if (cpu.sp > 0) {
+		ret = stack[cpu.sp - 1];
+	}
+	return true;
+#endif
+}
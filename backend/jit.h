@@ -0,0 +1,91 @@
+/**
+ * @file jit.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "emitter.h"
+#include "instruction.h"
+
+// Baseline template JIT: every opcode of a verified program is a fixed machine-code template.
+// The operand stack is the same memory as interpreter's, rbx is sp and r12 is bp,
+// functions call each other with native call and ret on a stack of their own.
+class Jit : private Emitter {
+public:
+    Jit() = default;
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+    ~Jit();
+
+    // false if the program or the target is not supported, the interpreter runs it then
+    bool Compile(const Program& program);
+
+    // runs on the stack of cpu, frameSize limits the depth of calls as the control stack does
+    bool Run(Cpu& cpu, size_t frameSize, var& ret);
+
+    // machine code size in bytes
+    inline size_t GetCodeSize() const {
+        return size_;
+    }
+
+    // status of leaving the machine code
+    enum Status : int32_t {
+        OK = 0,
+        EXIT,
+        DIVIDED_BY_ZERO,
+        OVERFLOW,
+        // mod by zero, and div or mod of LLONG_MIN by -1
+        MOD_BY_ZERO,
+        DIV_OVERFLOW,
+        MOD_OVERFLOW
+    };
+
+    // shared with the machine code, offsets are used by templates
+    struct Context {
+        var* sp;
+        var* bp;
+        var* limit;
+        uint64_t depth;
+        void* nativeStack;
+        void* savedRsp;
+        uint64_t ip;
+        var exitCode;
+    };
+
+private:
+    void Release();
+
+    // leave the machine code with status, edx carries ip of instruction
+    void Leave(Status status, uint64_t ip);
+
+    bool Template(const Program& program, uint32_t funcIdx, uint64_t ip);
+    void Prologue(const FuncInfo& func, size_t& tailEntry);
+    // binary operator of rax and rcx, the divisor is checked
+    bool Operate(OpCode op, uint64_t ip);
+
+    // offsets of code of bytecode, and entries of funcs
+    std::vector<size_t> natives_;
+    std::vector<size_t> entries_;
+    std::vector<size_t> tailEntries_;
+    std::vector<std::pair<size_t, uint64_t>> jumps_;
+    std::vector<std::pair<size_t, uint64_t>> calls_;
+    std::vector<std::pair<size_t, uint64_t>> tailCalls_;
+    size_t exitStub_{ 0 };
+    // locals of the top level code
+    uint32_t varc_{ 0 };
+
+    void* code_{ nullptr };
+    size_t size_{ 0 };
+    void* stack_{ nullptr };
+    size_t stackSize_{ 0 };
+};
+
+#endif
@@ -9,31 +9,153 @@
  * 
  */
 
- #include <iostream>
+ #include <fstream>
+#include <iostream>
 
 #include "assembler.h"
 #include "executor.h"
+#include "fuser.h"
+#include "optimizer.h"
+#include "utils.h"
+#include "verifier.h"
 
-bool Sim(const std::string& cfile, bool do_main, bool do_exit) {
+struct Options {
+	std::string file;
+	bool doMain{ true };
+	bool doExit{ true };
+	bool verify{ true };
+	// passes over the IRs before they are encoded
+	bool optimize{ true };
+	bool fold{ true };
+	bool deadCode{ true };
+	bool thread{ true };
+	bool tailCall{ true };
+	bool reduce{ true };
+	bool reuse{ true };
+	bool hoist{ true };
+	bool inlining{ true };
+	uint64_t inlineSize{ DEFAULT_INLINE_SIZE };
+	uint64_t inlineGrowth{ DEFAULT_INLINE_GROWTH };
+	bool unroll{ true };
+	uint64_t unrollFactor{ DEFAULT_UNROLL_FACTOR };
+	// counts of jz written by a run, and read by a later one to lay out blocks
+	std::string profileOut;
+	std::string profile;
+	// superinstructions, off to compare with the plain bytecode
+	bool fuse{ true };
+	// register code translated from the stack code
+	bool reg{ false };
+	// machine code of x86-64
+	bool jit{ false };
+	// C++ built to a shared object by the system compiler, cached in aotDir or the cache of user
+	bool aot{ false };
+	std::string aotDir;
+	// hot functions and loops go to register code
+	bool tier{ false };
+	// hot loops are traced to machine code, after tierLoops iterations
+	bool traceJit{ false };
+	uint64_t tierCalls{ DEFAULT_CALL_THRESHOLD };
+	uint64_t tierLoops{ DEFAULT_LOOP_THRESHOLD };
+	// checked handlers with UNINIT tracking, even for verified code
+	bool debug{ false };
+	TraceLevel traceLevel{ TraceLevel::OFF };
+	bool stats{ false };
+	std::string traceFile;
+};
+
+bool Sim(const Options& options) {
+	const auto& cfile = options.file;
 	Assembler asmer;
-	if (!asmer.Assemble(cfile, do_main, do_exit)) {
+	if (!asmer.Assemble(cfile, options.doMain, options.doExit)) {
 		std::cerr << "[err]: Assemble " << cfile << " failed" << std::endl;
 		return false;
 	}
+	if (!options.profile.empty() && !asmer.LoadProfile(options.profile)) {
+		return false;
+	}
+
+	std::ofstream traceFile;
+	if (!options.traceFile.empty()) {
+		traceFile.open(options.traceFile);
+		if (!traceFile) {
+			std::cerr << "[err]: Open " << options.traceFile << " failed" << std::endl;
+			return false;
+		}
+	}
+	Tracer tracer{ options.traceFile.empty() ? std::cerr : traceFile, options.traceLevel };
+	tracer.SetStats(options.stats);
+	tracer.SetProfile(!options.profileOut.empty());
+
 	auto code = asmer.GetCode();
-	code.Print();
+	auto program = asmer.GetProgram();
+	if (options.optimize) {
+		// the program of the original IRs is kept if an optimized one cannot be encoded
+		Optimizer optimizer;
+		optimizer.SetFold(options.fold);
+		optimizer.SetDeadCode(options.deadCode);
+		optimizer.SetThread(options.thread);
+		optimizer.SetTailCall(options.tailCall);
+		optimizer.SetReduce(options.reduce);
+		optimizer.SetReuse(options.reuse);
+		optimizer.SetHoist(options.hoist);
+		optimizer.SetInline(options.inlining);
+		optimizer.SetInlineBudget(options.inlineSize, options.inlineGrowth);
+		optimizer.SetUnroll(options.unroll);
+		optimizer.SetUnrollBudget(static_cast<uint32_t>(options.unrollFactor), DEFAULT_UNROLL_SIZE, DEFAULT_UNROLL_GROWTH);
+		Code optimized = code;
+		Program encoded;
+		if (optimizer.Optimize(optimized) && Assembler::Encode(optimized, encoded)) {
+			code = std::move(optimized);
+			program = std::move(encoded);
+		} else {
+			std::cerr << "[warn]: " << cfile << " is not optimized" << std::endl;
+		}
+	}
+	Verifier verifier;
+	if (options.verify && !verifier.Verify(program)) {
+		std::cerr << "[warn]: " << cfile << " is not verified, run with checks" << std::endl;
+	}
+	if (options.fuse) {
+		Fuser fuser;
+		fuser.Fuse(program);
+	}
+	if (tracer.IsOn(TraceLevel::INSTS)) {
+		code.Print();
+		program.Print();
+	}
 
 	Executor executor;
+	executor.SetTracer(&tracer);
+	executor.SetChecked(options.debug);
+	executor.SetRegister(options.reg);
+	executor.SetJit(options.jit);
+	executor.SetAot(options.aot, options.aotDir);
+	executor.SetTiering(options.tier, options.tierCalls, options.tierLoops);
+	executor.SetTraceJit(options.traceJit);
 	var ret;
-	if (!executor.Run(code, ret)) {
+	if (!executor.Run(program, ret)) {
 		std::cerr << "[err]: Execute " << cfile << " failed" << std::endl;
 		return false;
 	}
+	if (tracer.IsStats()) {
+		tracer.Stats();
+	}
+	if (tracer.IsProfile() && !tracer.Profile(program, options.profileOut)) {
+		return false;
+	}
 	var exit_code = executor.GetExit();
 	std::cout << "**********[exit]: " << exit_code << std::endl;
 	return true;
 }
 
+bool Sim(const std::string& cfile, bool do_main, bool do_exit) {
+	Options options;
+	options.file = cfile;
+	options.doMain = do_main;
+	options.doExit = do_exit;
+	return Sim(options);
+}
+
 void test_epxr() {
 	std::string path;
 	// path = "/mnt/d/work/prj/hyc/backend/test/test_expr.asm";
@@ -74,10 +196,122 @@ void test_while() {
 	static_assert(true);
 }
 
-int main() {
+static void Usage() {
+	std::cerr << "usage: hysim [--trace=off|calls|insts|full] [--trace-file=path] [--stats] [--profile-out=path] [--profile=path] "
+		"[--no-verify] [--no-opt] [--no-fold] [--no-dead-code] [--no-thread] [--no-tail-call] [--no-reduce] [--no-reuse] [--no-hoist] [--no-inline] [--inline-size=n] [--inline-growth=percent] [--no-unroll] [--unroll-factor=n] [--no-fuse] [--reg] [--jit] [--aot] [--aot-dir=path] [--tier] [--trace-jit] [--tier-calls=n] [--tier-loops=n] [--debug] [--no-main] [--no-exit] file.asm" << std::endl;
+}
+
+static bool ParseCount(const std::string& str, uint64_t& count) {
+	if (str.empty() || str.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+	try {
+		count = std::stoull(str);
+	} catch (const std::exception&) {
+		return false;
+	}
+	return true;
+}
+
+static bool ParseArgs(int argc, char* argv[], Options& options) {
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		std::string key;
+		std::string value;
+		Utils::Partition(arg, "=", key, value);
+		if (key == "--trace") {
+			if (!GetTraceLevel(value, options.traceLevel)) {
+				return false;
+			}
+		} else if (key == "--trace-file") {
+			options.traceFile = value;
+		} else if (key == "--stats") {
+			options.stats = true;
+		} else if (key == "--profile-out" || key == "--profile") {
+			if (value.empty()) {
+				return false;
+			}
+			(key == "--profile-out" ? options.profileOut : options.profile) = value;
+		} else if (key == "--tier") {
+			options.tier = true;
+		} else if (key == "--trace-jit") {
+			options.traceJit = true;
+		} else if (key == "--tier-calls" || key == "--tier-loops") {
+			uint64_t threshold = 0;
+			if (!ParseCount(value, threshold)) {
+				return false;
+			}
+			(key == "--tier-calls" ? options.tierCalls : options.tierLoops) = threshold;
+			options.tier = true;
+		} else if (key == "--aot") {
+			options.aot = true;
+		} else if (key == "--aot-dir") {
+			options.aotDir = value;
+			options.aot = true;
+		} else if (key == "--jit") {
+			options.jit = true;
+		} else if (key == "--reg") {
+			options.reg = true;
+		} else if (key == "--no-opt") {
+			options.optimize = false;
+		} else if (key == "--no-fold") {
+			options.fold = false;
+		} else if (key == "--no-dead-code") {
+			options.deadCode = false;
+		} else if (key == "--no-thread") {
+			options.thread = false;
+		} else if (key == "--no-tail-call") {
+			options.tailCall = false;
+		} else if (key == "--no-reduce") {
+			options.reduce = false;
+		} else if (key == "--no-reuse") {
+			options.reuse = false;
+		} else if (key == "--no-hoist") {
+			options.hoist = false;
+		} else if (key == "--no-inline") {
+			options.inlining = false;
+		} else if (key == "--inline-size" || key == "--inline-growth") {
+			if (!ParseCount(value, key == "--inline-size" ? options.inlineSize : options.inlineGrowth)) {
+				return false;
+			}
+		} else if (key == "--no-unroll") {
+			options.unroll = false;
+		} else if (key == "--unroll-factor") {
+			if (!ParseCount(value, options.unrollFactor) || options.unrollFactor > DEFAULT_UNROLL_SIZE) {
+				return false;
+			}
+		} else if (key == "--no-fuse") {
+			options.fuse = false;
+		} else if (key == "--no-verify") {
+			options.verify = false;
+		} else if (key == "--debug") {
+			options.debug = true;
+		} else if (key == "--no-main") {
+			options.doMain = false;
+		} else if (key == "--no-exit") {
+			options.doExit = false;
+		} else if (!arg.empty() && arg[0] != '-' && options.file.empty()) {
+			options.file = arg;
+		} else {
+			return false;
+		}
+	}
+	return !options.file.empty();
+}
+
+int main(int argc, char* argv[]) {
+	if (argc > 1) {
+		Options options;
+		if (!ParseArgs(argc, argv, options)) {
+			Usage();
+			return 1;
+		}
+		return Sim(options) ? 0 : 1;
+	}
+
 	//test_epxr();
 	test_func();
 	test_ifelse();
 	test_while();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,2185 @@
+/**
+ * @file optimizer.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "optimizer.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "utils.h"
+
+namespace {
+
+const constexpr char* ENDFUNC_LABEL = "ENDFUNC";
+
+// shl, shr and mask take the bits of 2^k as argument
+inline bool IsShift(InstructionType type) {
+	return type == InstructionType::SHL || type == InstructionType::SHR || type == InstructionType::MASK;
+}
+
+inline bool IsUnary(InstructionType type) {
+	return type == InstructionType::NEG || type == InstructionType::NOT || IsShift(type);
+}
+
+inline bool IsBinary(InstructionType type) {
+	return type >= InstructionType::ADD && type <= InstructionType::CMPLE && !IsUnary(type);
+}
+
+inline bool IsCommutative(InstructionType type) {
+	switch (type) {
+	case InstructionType::ADD:
+	case InstructionType::MUL:
+	case InstructionType::AND:
+	case InstructionType::OR:
+	case InstructionType::BITAND:
+	case InstructionType::BITOR:
+	case InstructionType::BITXOR:
+	case InstructionType::CMPEQ:
+	case InstructionType::CMPNE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// IRs an operator costs in the dispatch loop, as a multiply or a divide is slower
+inline size_t Weight(InstructionType type) {
+	switch (type) {
+	case InstructionType::MUL:
+		return 2;
+	case InstructionType::DIV:
+	case InstructionType::MOD:
+		return 4;
+	default:
+		return 1;
+	}
+}
+
+inline bool IsCall(InstructionType type) {
+	return type == InstructionType::CALL || type == InstructionType::TAILCALL;
+}
+
+inline bool IsControl(InstructionType type) {
+	return type == InstructionType::JMP || type == InstructionType::JZ ||
+		type == InstructionType::RET || type == InstructionType::EXIT || type == InstructionType::TAILCALL;
+}
+
+// a division which traps is left to run
+inline bool IsFoldable(InstructionType type, var left, var right) {
+	if (type != InstructionType::DIV && type != InstructionType::MOD) {
+		return true;
+	}
+	return right != 0 && !IsOverflow(left, right);
+}
+
+// compare of the negated condition
+InstructionType Invert(InstructionType type) {
+	switch (type) {
+	case InstructionType::CMPEQ:
+		return InstructionType::CMPNE;
+	case InstructionType::CMPNE:
+		return InstructionType::CMPEQ;
+	case InstructionType::CMPGT:
+		return InstructionType::CMPLE;
+	case InstructionType::CMPLT:
+		return InstructionType::CMPGE;
+	case InstructionType::CMPGE:
+		return InstructionType::CMPLT;
+	case InstructionType::CMPLE:
+		return InstructionType::CMPGT;
+	default:
+		return InstructionType::NIL;
+	}
+}
+
+// the arithmetic opcodes have the same order as instructions
+inline var Calculate(InstructionType type, var left, var right) {
+	return Evaluate(static_cast<OpCode>(static_cast<int>(type)), left, right);
+}
+
+inline bool ParseBits(const std::string& argument, var& bits) {
+	return Utils::ParseInteger(argument, bits) && bits >= 1 && bits <= MAX_SHIFT;
+}
+
+// k of value 2^k, or 0 if it is not a power of two which shl, shr and mask take
+var Log2(var value) {
+	for (var bits = 1; bits <= MAX_SHIFT; bits++) {
+		if (value == 1LL << bits) {
+			return bits;
+		}
+	}
+	return 0;
+}
+
+inline var Calculate(const IntermediateRepresentation& ir, var value) {
+	var bits = 0;
+	switch (ir.instruction) {
+	case InstructionType::NEG:
+		return Calculate(InstructionType::SUB, 0LL, value);
+	case InstructionType::NOT:
+		return !value;
+	default:
+		ParseBits(ir.argument, bits);
+		return Evaluate(ir.instruction == InstructionType::SHL ? OpCode::SHLI :
+			ir.instruction == InstructionType::SHR ? OpCode::SHRI : OpCode::MASKI, value, bits);
+	}
+}
+
+} // namespace
+
+bool Optimizer::Optimize(Code& code) {
+	inlineBudget_ = code.irs.size() * inlineGrowth_ / 100;
+	// a small program has room for a loop at least
+	unrollBudget_ = std::max(code.irs.size() * unrollGrowth_ / 100, unrollSize_);
+	unrolledLoops_.clear();
+	for (uint32_t round = 0; round < MAX_OPTIMIZE_ROUNDS; round++) {
+		changed_ = false;
+		if ((inline_ && !Inline(code)) ||
+			(fold_ && !Run(code, &Optimizer::Fold)) ||
+			(reduce_ && !Run(code, &Optimizer::Reduce)) ||
+			(reuse_ && !Run(code, &Optimizer::Reuse)) ||
+			(hoist_ && !Run(code, &Optimizer::Hoist)) ||
+			(unroll_ && !Run(code, &Optimizer::Unroll)) ||
+			(deadCode_ && !Run(code, &Optimizer::Eliminate)) ||
+			(thread_ && !Run(code, &Optimizer::Thread)) ||
+			(tailCall_ && !Run(code, &Optimizer::TailCall))) {
+			return false;
+		}
+		if (!changed_) {
+			break;
+		}
+	}
+	// jumps of the new layout are threaded again
+	if (!code.branches.empty() && (!Layout(code) || (thread_ && !Run(code, &Optimizer::Thread)))) {
+		return false;
+	}
+	if (thread_) {
+		MergeLabels(code);
+	}
+	return !(inline_ || deadCode_) || Prune(code);
+}
+
+bool Optimizer::Run(Code& code, Pass pass) {
+	if (!Split(code)) {
+		return false;
+	}
+	deleted_.assign(code.irs.size(), false);
+	inserts_.clear();
+	for (const auto& func : funcs_) {
+		// a function which cannot be analyzed is kept as it is
+		if (Propagate(code, func)) {
+			(this->*pass)(code, func);
+		}
+	}
+	Compact(code);
+	return true;
+}
+
+bool Optimizer::Split(const Code& code) {
+	std::vector<std::pair<uint64_t, std::string>> entries;
+	for (const auto& it : code.funcMap) {
+		entries.push_back({ it.second, it.first });
+	}
+	std::sort(entries.begin(), entries.end());
+
+	funcs_.clear();
+	argcs_.clear();
+	funcs_.push_back({ "", 0, entries.empty() ? code.irs.size() : entries[0].first, {} });
+	for (size_t f = 0; f < entries.size(); f++) {
+		size_t end = f + 1 < entries.size() ? entries[f + 1].first : code.irs.size();
+		funcs_.push_back({ entries[f].second, entries[f].first, end, {} });
+	}
+
+	for (auto& func : funcs_) {
+		if (func.begin > func.end || func.end > code.irs.size()) {
+			return false;
+		}
+		// args first and then locals, as the frame of Assembler::Encode
+		std::vector<std::string> args;
+		std::vector<std::string> locals;
+		for (size_t i = func.begin; i < func.end; i++) {
+			const auto& ir = code.irs[i];
+			if (ir.instruction != InstructionType::ARG && ir.instruction != InstructionType::VAR) {
+				continue;
+			}
+			std::vector<std::string> names;
+			Utils::Split(ir.argument, ",", names);
+			auto& slots = ir.instruction == InstructionType::ARG ? args : locals;
+			slots.insert(slots.end(), names.begin(), names.end());
+		}
+		argcs_[func.name] = static_cast<uint32_t>(args.size());
+		args.insert(args.end(), locals.begin(), locals.end());
+		for (uint32_t i = 0; i < args.size(); i++) {
+			func.slots[args[i]] = i;
+		}
+	}
+	return true;
+}
+
+bool Optimizer::Target(const Code& code, const Func& func, const std::string& label, size_t& target) const {
+	auto it = code.labelMap.find(label);
+	if (it == code.labelMap.end()) {
+		return false;
+	}
+	target = it->second;
+	return target == code.irs.size() || (target >= func.begin && target < func.end);
+}
+
+bool Optimizer::Successors(const Code& code, const Func& func, size_t i, std::vector<size_t>& successors) const {
+	successors.clear();
+	const auto& ir = code.irs[i];
+	if (ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) {
+		size_t target = 0;
+		if (!Target(code, func, ir.argument, target)) {
+			return false;
+		}
+		if (target != code.irs.size()) {
+			successors.push_back(target);
+		}
+	}
+	if (ir.instruction != InstructionType::JMP && ir.instruction != InstructionType::RET &&
+		ir.instruction != InstructionType::EXIT && ir.instruction != InstructionType::TAILCALL &&
+		i + 1 < func.end) {
+		successors.push_back(i + 1);
+	}
+	return true;
+}
+
+void Optimizer::Targets(const Code& code, const Func& func, std::vector<bool>& targets) const {
+	targets.assign(func.end - func.begin, false);
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& ir = code.irs[i];
+		size_t target = 0;
+		if ((ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) &&
+			Target(code, func, ir.argument, target) && target != code.irs.size()) {
+			targets[target - func.begin] = true;
+		}
+	}
+}
+
+bool Optimizer::Propagate(const Code& code, const Func& func) {
+	states_.assign(func.end - func.begin, State{});
+	if (func.begin == func.end) {
+		return true;
+	}
+
+	// args and uninitialized locals are unknown
+	auto& entry = states_[0];
+	entry.reached = true;
+	entry.locals.assign(func.slots.size(), { Value::VARYING, 0LL });
+
+	std::vector<size_t> worklist{ func.begin };
+	std::vector<size_t> successors;
+	while (!worklist.empty()) {
+		size_t i = worklist.back();
+		worklist.pop_back();
+
+		State state = states_[i - func.begin];
+		if (!Transfer(code.irs[i], func, state) || !Successors(code, func, i, successors)) {
+			return false;
+		}
+		for (auto successor : successors) {
+			bool changed = false;
+			if (!Merge(states_[successor - func.begin], state, changed)) {
+				return false;
+			}
+			if (changed) {
+				worklist.push_back(successor);
+			}
+		}
+	}
+	return true;
+}
+
+bool Optimizer::Transfer(const IntermediateRepresentation& ir, const Func& func, State& state) const {
+	auto& stack = state.stack;
+	auto slot = [&func](const std::string& name, uint32_t& idx) {
+		auto it = func.slots.find(name);
+		if (it == func.slots.end()) {
+			return false;
+		}
+		idx = it->second;
+		return true;
+	};
+
+	uint32_t idx = 0;
+	Value value{ Value::VARYING, 0LL };
+	switch (ir.instruction) {
+	case InstructionType::PUSH:
+		if (Utils::ParseInteger(ir.argument, value.imm)) {
+			value.kind = Value::CONST;
+		} else if (slot(ir.argument, idx)) {
+			value = state.locals[idx];
+		} else {
+			return false;
+		}
+		stack.push_back(value);
+		break;
+	case InstructionType::POP:
+		if (stack.empty()) {
+			return false;
+		}
+		if (!ir.argument.empty()) {
+			if (!slot(ir.argument, idx)) {
+				return false;
+			}
+			state.locals[idx] = stack.back();
+		}
+		stack.pop_back();
+		break;
+	case InstructionType::JZ:
+		if (stack.empty()) {
+			return false;
+		}
+		stack.pop_back();
+		break;
+	case InstructionType::CALL:
+	case InstructionType::TAILCALL: {
+		auto it = argcs_.find(ir.argument);
+		if (it == argcs_.end() || ir.argument.empty() || stack.size() < it->second) {
+			return false;
+		}
+		stack.resize(stack.size() - it->second);
+		if (ir.instruction == InstructionType::CALL) {
+			stack.push_back({ Value::VARYING, 0LL });
+		}
+		break;
+	}
+	case InstructionType::RET:
+	case InstructionType::EXIT:
+		if (ir.argument == "~") {
+			if (stack.empty()) {
+				return false;
+			}
+			stack.pop_back();
+		} else if (!ir.argument.empty() && !Utils::ParseInteger(ir.argument, value.imm) &&
+			!slot(ir.argument, idx)) {
+			return false;
+		}
+		break;
+	case InstructionType::JMP:
+	case InstructionType::ARG:
+	case InstructionType::VAR:
+		break;
+	default:
+		if (IsUnary(ir.instruction)) {
+			if (stack.empty() || (IsShift(ir.instruction) && !ParseBits(ir.argument, value.imm))) {
+				return false;
+			}
+			auto& operand = stack.back();
+			if (operand.kind == Value::CONST) {
+				operand.imm = Calculate(ir, operand.imm);
+			}
+		} else if (IsBinary(ir.instruction)) {
+			if (stack.size() < 2) {
+				return false;
+			}
+			auto right = stack.back();
+			stack.pop_back();
+			auto& left = stack.back();
+			if (left.kind == Value::CONST && right.kind == Value::CONST &&
+				IsFoldable(ir.instruction, left.imm, right.imm)) {
+				left.imm = Calculate(ir.instruction, left.imm, right.imm);
+			} else {
+				left = { Value::VARYING, 0LL };
+			}
+		} else {
+			return false;
+		}
+		break;
+	}
+	return true;
+}
+
+bool Optimizer::Merge(State& into, const State& from, bool& changed) {
+	if (!into.reached) {
+		into = from;
+		changed = true;
+		return true;
+	}
+	// the stack code keeps the same depth at a label on every path
+	if (into.stack.size() != from.stack.size()) {
+		return false;
+	}
+
+	auto meet = [&changed](Value& value, const Value& other) {
+		if (value.kind == Value::VARYING || other.kind == Value::UNDEF ||
+			(value.kind == Value::CONST && other.kind == Value::CONST && value.imm == other.imm)) {
+			return;
+		}
+		value = value.kind == Value::UNDEF ? other : Value{ Value::VARYING, 0LL };
+		changed = true;
+	};
+	for (size_t i = 0; i < into.locals.size(); i++) {
+		meet(into.locals[i], from.locals[i]);
+	}
+	for (size_t i = 0; i < into.stack.size(); i++) {
+		meet(into.stack[i], from.stack[i]);
+	}
+	return true;
+}
+
+bool Optimizer::Substitute(Code& code, const Func& func) {
+	bool substituted = false;
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& state = states_[i - func.begin];
+		auto& ir = code.irs[i];
+		if (!state.reached ||
+			(ir.instruction != InstructionType::PUSH && ir.instruction != InstructionType::RET &&
+			ir.instruction != InstructionType::EXIT)) {
+			continue;
+		}
+		auto it = func.slots.find(ir.argument);
+		if (it == func.slots.end()) {
+			continue;
+		}
+		const auto& value = state.locals[it->second];
+		if (value.kind == Value::CONST) {
+			ir.argument = std::to_string(value.imm);
+			substituted = true;
+		}
+	}
+	changed_ = changed_ || substituted;
+	return substituted;
+}
+
+bool Optimizer::Fold(Code& code, const Func& func) {
+	// operand of the block, producer is the push of its immediate, or npos
+	struct Operand {
+		size_t producer;
+		var imm;
+	};
+	constexpr size_t npos = static_cast<size_t>(-1);
+
+	Substitute(code, func);
+
+	std::vector<bool> targets;
+	Targets(code, func, targets);
+
+	bool folded = false;
+	bool live = false;
+	bool start = true;
+	std::vector<Operand> stack;
+	for (size_t i = func.begin; i < func.end; i++) {
+		if (deleted_[i]) {
+			continue;
+		}
+		const auto& state = states_[i - func.begin];
+		if (start || targets[i - func.begin]) {
+			live = state.reached;
+			stack.assign(state.stack.size(), { npos, 0LL });
+		}
+		auto& ir = code.irs[i];
+		start = IsControl(ir.instruction);
+		if (!live) {
+			continue;
+		}
+
+		var imm = 0LL;
+		switch (ir.instruction) {
+		case InstructionType::PUSH:
+			stack.push_back({ Utils::ParseInteger(ir.argument, imm) ? i : npos, imm });
+			break;
+		case InstructionType::POP:
+			if (ir.argument.empty() && stack.back().producer != npos) {
+				// push k; pop
+				Delete(stack.back().producer);
+				Delete(i);
+				folded = true;
+			}
+			stack.pop_back();
+			break;
+		case InstructionType::JZ: {
+			auto cond = stack.back();
+			stack.pop_back();
+			if (cond.producer == npos) {
+				break;
+			}
+			Delete(cond.producer);
+			if (cond.imm == 0LL) {
+				ir.instruction = InstructionType::JMP;
+			} else {
+				Delete(i);
+			}
+			folded = true;
+			break;
+		}
+		case InstructionType::CALL:
+			stack.resize(stack.size() - argcs_[ir.argument]);
+			stack.push_back({ npos, 0LL });
+			break;
+		case InstructionType::TAILCALL:
+			stack.resize(stack.size() - argcs_[ir.argument]);
+			break;
+		case InstructionType::RET:
+		case InstructionType::EXIT:
+			if (ir.argument == "~") {
+				stack.pop_back();
+			}
+			break;
+		case InstructionType::JMP:
+		case InstructionType::ARG:
+		case InstructionType::VAR:
+			break;
+		default:
+			if (IsUnary(ir.instruction)) {
+				auto& operand = stack.back();
+				if (operand.producer == npos) {
+					break;
+				}
+				Delete(operand.producer);
+				operand = { i, Calculate(ir, operand.imm) };
+			} else {
+				auto right = stack.back();
+				stack.pop_back();
+				auto& left = stack.back();
+				if (left.producer == npos || right.producer == npos ||
+					!IsFoldable(ir.instruction, left.imm, right.imm)) {
+					left = { npos, 0LL };
+					break;
+				}
+				Delete(left.producer);
+				Delete(right.producer);
+				left = { i, Calculate(ir.instruction, left.imm, right.imm) };
+			}
+			ir.instruction = InstructionType::PUSH;
+			ir.argument = std::to_string(stack.back().imm);
+			folded = true;
+			break;
+		}
+	}
+	return folded;
+}
+
+bool Optimizer::Reduce(Code& code, const Func& func) {
+	// operand of the block: producer is the push of its immediate or npos, op is the IR computing it.
+	// boolean if it is 0 or 1, and inner if the operand of its not is
+	struct Operand {
+		size_t producer;
+		var imm;
+		size_t op;
+		bool boolean;
+		bool inner;
+	};
+	constexpr size_t npos = static_cast<size_t>(-1);
+	const Operand unknown{ npos, 0LL, npos, false, false };
+
+	std::vector<bool> targets;
+	Targets(code, func, targets);
+	// jz only tests its condition against 0
+	auto feedsJz = [this, &code, &func](size_t i) {
+		do {
+			i++;
+		} while (i < func.end && deleted_[i]);
+		return i < func.end && code.irs[i].instruction == InstructionType::JZ;
+	};
+
+	bool reduced = false;
+	bool live = false;
+	bool start = true;
+	std::vector<Operand> stack;
+	for (size_t i = func.begin; i < func.end; i++) {
+		if (deleted_[i]) {
+			continue;
+		}
+		const auto& state = states_[i - func.begin];
+		if (start || targets[i - func.begin]) {
+			live = state.reached;
+			stack.assign(state.stack.size(), unknown);
+		}
+		auto& ir = code.irs[i];
+		start = IsControl(ir.instruction);
+		if (!live) {
+			continue;
+		}
+
+		var imm = 0LL;
+		switch (ir.instruction) {
+		case InstructionType::PUSH:
+			if (Utils::ParseInteger(ir.argument, imm)) {
+				stack.push_back({ i, imm, npos, imm == 0LL || imm == 1LL, false });
+			} else {
+				stack.push_back(unknown);
+			}
+			break;
+		case InstructionType::POP:
+		case InstructionType::JZ:
+			stack.pop_back();
+			break;
+		case InstructionType::CALL:
+			stack.resize(stack.size() - argcs_[ir.argument]);
+			stack.push_back(unknown);
+			break;
+		case InstructionType::TAILCALL:
+			stack.resize(stack.size() - argcs_[ir.argument]);
+			break;
+		case InstructionType::RET:
+		case InstructionType::EXIT:
+			if (ir.argument == "~") {
+				stack.pop_back();
+			}
+			break;
+		case InstructionType::JMP:
+		case InstructionType::ARG:
+		case InstructionType::VAR:
+			break;
+		case InstructionType::NOT: {
+			auto& operand = stack.back();
+			// not; not of a boolean, or feeding jz, is the operand itself
+			if (operand.op != npos && code.irs[operand.op].instruction == InstructionType::NOT &&
+				(operand.inner || feedsJz(i))) {
+				Delete(operand.op);
+				Delete(i);
+				operand = { npos, 0LL, npos, operand.inner, false };
+				reduced = true;
+				break;
+			}
+			operand = { npos, 0LL, i, true, operand.boolean };
+			break;
+		}
+		default: {
+			if (IsUnary(ir.instruction)) {
+				stack.back() = unknown;
+				break;
+			}
+			auto right = stack.back();
+			stack.pop_back();
+			auto& left = stack.back();
+			auto type = ir.instruction;
+			bool boolean = (type >= InstructionType::CMPEQ && type <= InstructionType::CMPLE) ||
+				type == InstructionType::AND || type == InstructionType::OR;
+			// an operator of two immediates is left to Fold
+			if ((left.producer == npos) == (right.producer == npos)) {
+				left = { npos, 0LL, i, boolean, false };
+				break;
+			}
+			// the push of an immediate left operand comes before the other one, so it can only be deleted
+			bool commuted = left.producer != npos;
+			const auto& constant = commuted ? left : right;
+			auto value = commuted ? right : left;
+			size_t p = constant.producer;
+			var k = constant.imm;
+			// the least k has no magnitude in a var, its shift would be out of MAX_SHIFT anyway
+			var bits = k == LLONG_MIN ? 0 : Log2(k < 0 ? -k : k);
+			auto shift = [&code, p, bits](InstructionType shiftType) {
+				code.irs[p].instruction = shiftType;
+				code.irs[p].argument = std::to_string(bits);
+			};
+
+			bool identity = false;
+			auto result = Operand{ npos, 0LL, i, boolean, false };
+			switch (type) {
+			case InstructionType::ADD:
+			case InstructionType::BITOR:
+			case InstructionType::BITXOR:
+				identity = k == 0LL;
+				break;
+			case InstructionType::SUB:
+				identity = k == 0LL && !commuted;
+				if (k == 0LL && commuted) {
+					// 0 - x is neg
+					Delete(p);
+					ir.instruction = InstructionType::NEG;
+					reduced = true;
+				}
+				break;
+			case InstructionType::BITAND:
+				identity = k == -1LL;
+				break;
+			case InstructionType::MUL:
+				identity = k == 1LL;
+				if (k == -1LL || (bits > 0 && (k > 0 || !commuted))) {
+					// x * 2^k is shl k, x * -2^k is shl k; neg
+					if (k > 0 || k == -1LL) {
+						Delete(p);
+					} else {
+						shift(InstructionType::SHL);
+						changed_ = true;
+					}
+					ir.instruction = k > 0 ? InstructionType::SHL : InstructionType::NEG;
+					ir.argument = k > 0 ? std::to_string(bits) : "";
+					reduced = true;
+				}
+				break;
+			case InstructionType::DIV:
+				identity = k == 1LL && !commuted;
+				if (!commuted && bits > 0) {
+					// x / 2^k is shr k, x / -2^k is shr k; neg
+					if (k > 0) {
+						Delete(p);
+					} else {
+						shift(InstructionType::SHR);
+						changed_ = true;
+					}
+					ir.instruction = k > 0 ? InstructionType::SHR : InstructionType::NEG;
+					ir.argument = k > 0 ? std::to_string(bits) : "";
+					reduced = true;
+				}
+				break;
+			case InstructionType::MOD:
+				if (commuted) {
+					break;
+				}
+				if (bits > 0) {
+					// the remainder has the sign of x, whichever sign 2^k has
+					Delete(p);
+					ir.instruction = InstructionType::MASK;
+					ir.argument = std::to_string(bits);
+					reduced = true;
+				} else if (k == 1LL) {
+					// x is dropped for 0, x % -1 is kept as it traps for the least x
+					code.irs[p].instruction = InstructionType::POP;
+					code.irs[p].argument.clear();
+					ir.instruction = InstructionType::PUSH;
+					ir.argument = "0";
+					result = { i, 0LL, npos, true, false };
+					changed_ = true;
+					reduced = true;
+				}
+				break;
+			case InstructionType::CMPEQ:
+				if (k == 0LL) {
+					// x == 0 is not x
+					Delete(p);
+					ir.instruction = InstructionType::NOT;
+					result = { npos, 0LL, i, true, value.boolean };
+					reduced = true;
+				}
+				break;
+			case InstructionType::CMPNE:
+				identity = k == 0LL && (value.boolean || feedsJz(i));
+				break;
+			default:
+				break;
+			}
+			if (identity) {
+				Delete(p);
+				Delete(i);
+				result = value;
+				result.producer = npos;
+				reduced = true;
+			}
+			left = result;
+			break;
+		}
+		}
+	}
+	changed_ = changed_ || reduced;
+	return reduced;
+}
+
+void Optimizer::Trees(const Code& code, const Func& func, std::vector<Tree>& trees) {
+	constexpr size_t npos = static_cast<size_t>(-1);
+	const Tree unknown{ npos, "", {}, 0, false };
+	std::vector<bool> targets;
+	Targets(code, func, targets);
+	trees.assign(func.end - func.begin, unknown);
+
+	bool live = false;
+	bool start = true;
+	// the last IR which is not of an expression, e.g. pop x in the middle
+	size_t impure = npos;
+	std::vector<Tree> stack;
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& state = states_[i - func.begin];
+		if (start || targets[i - func.begin]) {
+			live = state.reached;
+			stack.assign(state.stack.size(), unknown);
+			impure = npos;
+		}
+		const auto& ir = code.irs[i];
+		start = IsControl(ir.instruction);
+		if (!live) {
+			continue;
+		}
+
+		auto valid = [impure](const Tree& tree) {
+			return tree.start != npos && (impure == npos || tree.start > impure);
+		};
+		const auto* name = instructionInfos[static_cast<size_t>(ir.instruction)].str;
+		if (ir.instruction == InstructionType::PUSH) {
+			stack.push_back({ i, ir.argument, {}, 1, false });
+			if (func.slots.count(ir.argument) == 1) {
+				stack.back().locals.push_back(ir.argument);
+			}
+			trees[i - func.begin] = stack.back();
+		} else if (IsUnary(ir.instruction)) {
+			auto& operand = stack.back();
+			if (!valid(operand)) {
+				operand = unknown;
+				continue;
+			}
+			operand.key = name + ir.argument + "(" + operand.key + ")";
+			operand.cost++;
+			trees[i - func.begin] = operand;
+		} else if (IsBinary(ir.instruction)) {
+			auto right = stack.back();
+			stack.pop_back();
+			auto& left = stack.back();
+			if (!valid(left) || !valid(right)) {
+				left = unknown;
+				continue;
+			}
+			// x / -1 traps for the least x
+			var divisor = 0;
+			bool safe = right.cost == 1 && Utils::ParseInteger(right.key, divisor) && divisor != 0 && divisor != -1;
+			left.traps = left.traps || right.traps ||
+				((ir.instruction == InstructionType::DIV || ir.instruction == InstructionType::MOD) && !safe);
+			// the same operands in either order are the same value
+			if (IsCommutative(ir.instruction) && right.key < left.key) {
+				std::swap(left.key, right.key);
+			}
+			left.key = std::string(name) + "(" + left.key + "," + right.key + ")";
+			left.locals.insert(left.locals.end(), right.locals.begin(), right.locals.end());
+			left.cost += right.cost + Weight(ir.instruction);
+			trees[i - func.begin] = left;
+		} else {
+			impure = i;
+			switch (ir.instruction) {
+			case InstructionType::POP:
+			case InstructionType::JZ:
+				stack.pop_back();
+				break;
+			case InstructionType::CALL:
+				stack.resize(stack.size() - argcs_[ir.argument]);
+				stack.push_back(unknown);
+				break;
+			case InstructionType::TAILCALL:
+				stack.resize(stack.size() - argcs_[ir.argument]);
+				break;
+			case InstructionType::RET:
+			case InstructionType::EXIT:
+				if (ir.argument == "~") {
+					stack.pop_back();
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+bool Optimizer::Reuse(Code& code, const Func& func) {
+	// the top level code has no frame for a hidden local
+	if (func.name.empty()) {
+		return false;
+	}
+	struct Occurrence {
+		size_t key;
+		size_t start;
+		size_t end;
+		size_t cost;
+	};
+	constexpr size_t npos = static_cast<size_t>(-1);
+
+	std::vector<Tree> trees;
+	Trees(code, func, trees);
+	std::map<std::string, size_t> keys;
+	std::vector<std::vector<std::string>> keyLocals;
+	std::vector<Occurrence> occurrences;
+	for (size_t i = func.begin; i < func.end; i++) {
+		// a push alone is not computed
+		const auto& tree = trees[i - func.begin];
+		if (tree.start == npos || tree.start == i) {
+			continue;
+		}
+		auto it = keys.find(tree.key);
+		if (it == keys.end()) {
+			it = keys.insert({ tree.key, keyLocals.size() }).first;
+			keyLocals.push_back(tree.locals);
+		}
+		occurrences.push_back({ it->second, tree.start, i, tree.cost });
+	}
+	if (occurrences.size() <= keys.size()) {
+		return false;
+	}
+
+	// expressions available before each IR: computed on every path to it, and none of
+	// their locals is assigned after
+	size_t size = func.end - func.begin;
+	std::vector<size_t> gens(size, npos);
+	for (const auto& occurrence : occurrences) {
+		gens[occurrence.end - func.begin] = occurrence.key;
+	}
+	std::vector<std::vector<bool>> ins(size);
+	ins[0].assign(keys.size(), false);
+	std::vector<size_t> worklist{ func.begin };
+	std::vector<size_t> successors;
+	while (!worklist.empty()) {
+		size_t i = worklist.back();
+		worklist.pop_back();
+		auto available = ins[i - func.begin];
+		const auto& ir = code.irs[i];
+		if (gens[i - func.begin] != npos) {
+			available[gens[i - func.begin]] = true;
+		}
+		if (ir.instruction == InstructionType::POP && !ir.argument.empty()) {
+			for (size_t k = 0; k < keyLocals.size(); k++) {
+				const auto& locals = keyLocals[k];
+				if (std::find(locals.begin(), locals.end(), ir.argument) != locals.end()) {
+					available[k] = false;
+				}
+			}
+		}
+		Successors(code, func, i, successors);
+		for (auto successor : successors) {
+			auto& in = ins[successor - func.begin];
+			auto merged = available;
+			if (!in.empty()) {
+				for (size_t k = 0; k < merged.size(); k++) {
+					merged[k] = merged[k] && in[k];
+				}
+			}
+			if (merged != in) {
+				in = merged;
+				worklist.push_back(successor);
+			}
+		}
+	}
+
+	std::vector<bool> redundant(occurrences.size(), false);
+	std::vector<size_t> savings(keys.size(), 0);
+	for (size_t o = 0; o < occurrences.size(); o++) {
+		const auto& occurrence = occurrences[o];
+		const auto& in = ins[occurrence.start - func.begin];
+		redundant[o] = !in.empty() && in[occurrence.key];
+		if (redundant[o]) {
+			savings[occurrence.key] += occurrence.cost - 1;
+		}
+	}
+
+	// a computation stores the value only if a reuse is reached before it is computed again,
+	// as the hidden local is live after it
+	std::vector<bool> stored(occurrences.size(), false);
+	std::vector<size_t> stores(keys.size(), 0);
+	std::vector<int> uses(size);
+	std::vector<bool> lives(size);
+	for (size_t k = 0; k < keys.size(); k++) {
+		if (savings[k] == 0) {
+			continue;
+		}
+		// 1 reads the local before the IR, -1 writes it
+		std::fill(uses.begin(), uses.end(), 0);
+		for (size_t o = 0; o < occurrences.size(); o++) {
+			if (occurrences[o].key == k) {
+				uses[redundant[o] ? occurrences[o].start - func.begin : occurrences[o].end - func.begin] = redundant[o] ? 1 : -1;
+			}
+		}
+		auto liveOut = [&](size_t i) {
+			bool live = false;
+			Successors(code, func, i, successors);
+			for (auto successor : successors) {
+				live = live || lives[successor - func.begin];
+			}
+			return live;
+		};
+		std::fill(lives.begin(), lives.end(), false);
+		for (bool changed = true; changed;) {
+			changed = false;
+			for (size_t i = func.end; i-- > func.begin;) {
+				int use = uses[i - func.begin];
+				bool live = use > 0 || (use == 0 && liveOut(i));
+				if (live != lives[i - func.begin]) {
+					lives[i - func.begin] = live;
+					changed = true;
+				}
+			}
+		}
+		for (size_t o = 0; o < occurrences.size(); o++) {
+			if (occurrences[o].key == k && !redundant[o] && liveOut(occurrences[o].end)) {
+				stored[o] = true;
+				stores[k] += 2;
+			}
+		}
+	}
+
+	// a value is stored by 2 IRs, so it is reused when more is saved.
+	// an expression inside another one which is reused may never run, they are not both reused
+	std::vector<size_t> order;
+	for (size_t k = 0; k < keys.size(); k++) {
+		if (savings[k] > stores[k]) {
+			order.push_back(k);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&savings](size_t a, size_t b) { return savings[a] > savings[b]; });
+
+	std::vector<bool> used(size, false);
+	std::string declared;
+	bool reused = false;
+	for (auto k : order) {
+		bool overlapped = false;
+		for (const auto& occurrence : occurrences) {
+			for (size_t j = occurrence.start; occurrence.key == k && j <= occurrence.end; j++) {
+				overlapped = overlapped || used[j - func.begin];
+			}
+		}
+		if (overlapped) {
+			continue;
+		}
+
+		std::string slot;
+		do {
+			slot = "_cse" + std::to_string(++reused_);
+		} while (func.slots.count(slot) == 1);
+		declared = declared.empty() ? slot : declared + ", " + slot;
+		for (size_t o = 0; o < occurrences.size(); o++) {
+			const auto& occurrence = occurrences[o];
+			if (occurrence.key != k) {
+				continue;
+			}
+			std::fill(used.begin() + (occurrence.start - func.begin), used.begin() + (occurrence.end - func.begin) + 1, true);
+			if (stored[o]) {
+				// the value stays on the stack
+				inserts_[occurrence.end] = { { "", InstructionType::POP, slot }, { "", InstructionType::PUSH, slot } };
+			}
+			if (!redundant[o]) {
+				continue;
+			}
+			for (size_t j = occurrence.start; j < occurrence.end; j++) {
+				Delete(j);
+			}
+			code.irs[occurrence.end].instruction = InstructionType::PUSH;
+			code.irs[occurrence.end].argument = slot;
+		}
+		reused = true;
+	}
+	if (!reused) {
+		return false;
+	}
+
+	Declare(code, func, declared);
+	return true;
+}
+
+bool Optimizer::Entered(const Code& code, const Func& func, size_t head, size_t tail) const {
+	// the IRs before head run whenever the loop is entered
+	if (head == func.begin || !states_[head - func.begin].reached) {
+		return false;
+	}
+	auto before = code.irs[head - 1].instruction;
+	if (before == InstructionType::JMP || before == InstructionType::RET || before == InstructionType::EXIT ||
+		before == InstructionType::TAILCALL) {
+		return false;
+	}
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& ir = code.irs[i];
+		size_t target = 0;
+		if ((i < head || i > tail) && (ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) &&
+			Target(code, func, ir.argument, target) && target >= head && target <= tail) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void Optimizer::Loops(const Code& code, const Func& func, std::vector<std::pair<size_t, size_t>>& loops) const {
+	// a jump back to a label, e.g. jmp _begWhile_1, closes a loop at it
+	std::map<size_t, size_t> tails;
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& ir = code.irs[i];
+		size_t target = 0;
+		if ((ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) &&
+			Target(code, func, ir.argument, target) && target <= i) {
+			tails[target] = i;
+		}
+	}
+	loops.assign(tails.begin(), tails.end());
+	std::sort(loops.begin(), loops.end(), [](const auto& a, const auto& b) {
+		return a.second - a.first < b.second - b.first;
+	});
+}
+
+bool Optimizer::Hoist(Code& code, const Func& func) {
+	// the top level code has no frame for a hidden local
+	if (func.name.empty()) {
+		return false;
+	}
+	constexpr size_t npos = static_cast<size_t>(-1);
+	// inner loops first, their expressions are not hoisted again by the outer ones in a round
+	std::vector<std::pair<size_t, size_t>> loops;
+	Loops(code, func, loops);
+
+	std::vector<Tree> trees;
+	Trees(code, func, trees);
+	std::vector<std::vector<bool>> ins;
+	Definite(code, func, argcs_[func.name], ins);
+	std::vector<bool> used(func.end - func.begin, false);
+	std::string declared;
+	for (const auto& [head, tail] : loops) {
+		// the preheader runs when the loop is entered
+		if (!Entered(code, func, head, tail)) {
+			continue;
+		}
+
+		// a call cannot assign the locals of its caller, only a pop in the loop does
+		std::vector<std::string> writes;
+		for (size_t i = head; i <= tail; i++) {
+			if (code.irs[i].instruction == InstructionType::POP && !code.irs[i].argument.empty()) {
+				writes.push_back(code.irs[i].argument);
+			}
+		}
+		auto invariant = [&](const Tree& tree) {
+			if (tree.traps) {
+				return false;
+			}
+			// the preheader runs even if the loop does not, so an unassigned local is not read early
+			for (const auto& local : tree.locals) {
+				if (std::find(writes.begin(), writes.end(), local) != writes.end() ||
+					!ins[head - func.begin][func.slots.at(local)]) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		// the outermost invariant expressions, the same ones share their hidden local
+		std::map<std::string, std::string> slots;
+		std::vector<IntermediateRepresentation> preheader;
+		for (size_t i = tail + 1; i-- > head;) {
+			const auto& tree = trees[i - func.begin];
+			if (tree.start == npos || tree.start == i || tree.start < head || !invariant(tree) ||
+				std::find(used.begin() + (tree.start - func.begin), used.begin() + (i - func.begin) + 1, true) !=
+				used.begin() + (i - func.begin) + 1) {
+				continue;
+			}
+			auto& slot = slots[tree.key];
+			if (slot.empty()) {
+				do {
+					slot = "_licm" + std::to_string(++hoisted_);
+				} while (func.slots.count(slot) == 1);
+				declared = declared.empty() ? slot : declared + ", " + slot;
+				for (size_t j = tree.start; j <= i; j++) {
+					preheader.push_back({ "", code.irs[j].instruction, code.irs[j].argument });
+				}
+				preheader.push_back({ "", InstructionType::POP, slot });
+			}
+			std::fill(used.begin() + (tree.start - func.begin), used.begin() + (i - func.begin) + 1, true);
+			for (size_t j = tree.start; j < i; j++) {
+				Delete(j);
+			}
+			code.irs[i].instruction = InstructionType::PUSH;
+			code.irs[i].argument = slot;
+			i = tree.start;
+		}
+		if (!preheader.empty()) {
+			auto& inserted = inserts_[head - 1];
+			inserted.insert(inserted.end(), preheader.begin(), preheader.end());
+		}
+	}
+	if (declared.empty()) {
+		return false;
+	}
+
+	Declare(code, func, declared);
+	return true;
+}
+
+bool Optimizer::Unroll(Code& code, const Func& func) {
+	// the top level code has no frame for a hidden local
+	if (func.name.empty()) {
+		return false;
+	}
+	std::vector<std::pair<size_t, size_t>> loops;
+	Loops(code, func, loops);
+	std::vector<Tree> trees;
+	Trees(code, func, trees);
+	// labels of each IR, their names are changed in the copies
+	std::map<uint64_t, std::vector<std::string>> labels;
+	for (const auto& it : code.labelMap) {
+		labels[it.second].push_back(it.first);
+	}
+
+	auto labeled = [&labels](size_t i) {
+		return labels.count(i) == 1;
+	};
+
+	std::vector<bool> used(func.end - func.begin, false);
+	std::string declared;
+	bool unrolled = false;
+	for (const auto& [head, tail] : loops) {
+		if (!labeled(head)) {
+			continue;
+		}
+		const auto& heads = labels[head];
+		if (code.irs[tail].instruction != InstructionType::JMP ||
+			std::any_of(heads.begin(), heads.end(), [this](const auto& label) { return unrolledLoops_.count(label) == 1; }) ||
+			std::find(used.begin() + (head - func.begin), used.begin() + (tail - func.begin) + 1, true) !=
+			used.begin() + (tail - func.begin) + 1 || !Entered(code, func, head, tail)) {
+			continue;
+		}
+
+		// while (i < bound) { body; i = i + step; }, the test is push i; bound; compare; jz exit
+		size_t test = head;
+		while (test < tail && code.irs[test].instruction != InstructionType::JZ) {
+			test++;
+		}
+		size_t exit = 0;
+		if (test + 5 > tail || test < head + 3 || trees[test - 1 - func.begin].start != head ||
+			trees[test - 2 - func.begin].start != head + 1 || code.irs[head].instruction != InstructionType::PUSH ||
+			func.slots.count(code.irs[head].argument) == 0 || !Target(code, func, code.irs[test].argument, exit) ||
+			(exit >= head && exit <= tail)) {
+			continue;
+		}
+		const auto& counter = code.irs[head].argument;
+		auto compare = code.irs[test - 1].instruction;
+		const auto& bound = trees[test - 2 - func.begin];
+
+		var step = 0;
+		const auto& load = code.irs[tail - 4];
+		const auto& add = code.irs[tail - 2];
+		const auto& store = code.irs[tail - 1];
+		if (load.instruction != InstructionType::PUSH || load.argument != counter ||
+			!Utils::ParseInteger(code.irs[tail - 3].argument, step) || code.irs[tail - 3].instruction != InstructionType::PUSH ||
+			(add.instruction != InstructionType::ADD && add.instruction != InstructionType::SUB) ||
+			store.instruction != InstructionType::POP || store.argument != counter ||
+			labeled(tail - 3) || labeled(tail - 2) || labeled(tail - 1) || labeled(tail) ||
+			step == 0 || step > INT_MAX || step < -INT_MAX) {
+			continue;
+		}
+		step = add.instruction == InstructionType::ADD ? step : -step;
+		// the loop ends as the counter moves to bound
+		bool up = step > 0;
+		if (up ? compare != InstructionType::CMPLT && compare != InstructionType::CMPLE :
+			compare != InstructionType::CMPGT && compare != InstructionType::CMPGE) {
+			continue;
+		}
+
+		// only the step assigns the counter and bound is not changed, a body jumps in itself or out of the loop.
+		// a jump to head, as continue, may skip the step
+		bool counted = !bound.traps;
+		for (size_t i = head; counted && i <= tail; i++) {
+			const auto& ir = code.irs[i];
+			size_t target = 0;
+			if (ir.instruction == InstructionType::POP && !ir.argument.empty()) {
+				counted = (ir.argument != counter || i == tail - 1) &&
+					std::find(bound.locals.begin(), bound.locals.end(), ir.argument) == bound.locals.end();
+			} else if (i > test && i < tail && (ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ)) {
+				counted = Target(code, func, ir.argument, target) &&
+					(target < head || target > tail || (target > test && target <= tail - 4));
+			}
+		}
+		size_t size = tail - test - 1;
+		if (!counted) {
+			continue;
+		}
+
+		std::string suffix;
+		std::string slot;
+		auto clash = [&code, &labels, &labeled, &suffix, head, test, tail](size_t copies) {
+			for (size_t i = test + 1; i < tail; i++) {
+				for (const auto& label : labeled(i) ? labels[i] : std::vector<std::string>{}) {
+					for (size_t c = 1; c <= copies; c++) {
+						if (code.labelMap.count(label + suffix + "_" + std::to_string(c)) == 1) {
+							return true;
+						}
+					}
+				}
+			}
+			return code.labelMap.count(labels[head][0] + suffix) == 1;
+		};
+		// a copy of the body whose labels and jumps in it are renamed, its vars are declared once
+		auto copy = [&](size_t c, std::vector<IntermediateRepresentation>& irs) {
+			std::string renamed = suffix + "_" + std::to_string(c);
+			std::string pending;
+			for (size_t i = test + 1; i < tail; i++) {
+				for (const auto& label : labeled(i) ? labels[i] : std::vector<std::string>{}) {
+					pending = pending.empty() ? label + renamed : pending + "," + label + renamed;
+				}
+				auto ir = code.irs[i];
+				if (ir.instruction == InstructionType::ARG || ir.instruction == InstructionType::VAR) {
+					continue;
+				}
+				ir.label = pending;
+				pending.clear();
+				size_t target = 0;
+				if ((ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) &&
+					Target(code, func, ir.argument, target) && target > test && target < tail) {
+					ir.argument += renamed;
+				}
+				irs.push_back(std::move(ir));
+			}
+		};
+		std::vector<IntermediateRepresentation> copies;
+
+		// a constant counter to a constant bound runs a known number of trips
+		State entry = states_[head - 1 - func.begin];
+		var limit = 0;
+		var trips = 0;
+		bool known = Transfer(code.irs[head - 1], func, entry) && test == head + 3 &&
+			Utils::ParseInteger(code.irs[head + 1].argument, limit) &&
+			entry.locals[func.slots.at(counter)].kind == Value::CONST;
+		for (var value = entry.locals[func.slots.at(counter)].imm;
+			known && trips <= MAX_UNROLL_TRIPS && Calculate(compare, value, limit) != 0; trips++) {
+			value = Calculate(InstructionType::ADD, value, step);
+		}
+		if (known && trips <= MAX_UNROLL_TRIPS && static_cast<size_t>(trips) * size <= std::min(unrollSize_, unrollBudget_)) {
+			do {
+				suffix = "_unr" + std::to_string(++unrolled_);
+			} while (clash(static_cast<size_t>(trips)));
+			for (var c = 1; c <= trips; c++) {
+				copy(static_cast<size_t>(c), copies);
+			}
+			if (exit != tail + 1) {
+				copies.push_back({ "", InstructionType::JMP, code.irs[test].argument });
+			}
+			for (size_t i = head; i <= tail; i++) {
+				Delete(i);
+			}
+			unrollBudget_ -= static_cast<size_t>(trips) * size;
+		} else {
+			if (unrollFactor_ < 2 || size * unrollFactor_ > std::min(unrollSize_, unrollBudget_)) {
+				continue;
+			}
+			do {
+				suffix = "_unr" + std::to_string(++unrolled_);
+				slot = suffix;
+			} while (clash(unrollFactor_) || func.slots.count(slot) == 1);
+			declared = declared.empty() ? slot : declared + ", " + slot;
+
+			// the copies run while the counter passes limit = bound - distance, so no copy passes bound.
+			// the loop as it is runs the trips left, or all of them if limit wraps
+			const auto& remainder = labels[head][0];
+			std::vector<IntermediateRepresentation> computed;
+			for (size_t i = head + 1; i <= test - 2; i++) {
+				computed.push_back({ "", code.irs[i].instruction, code.irs[i].argument });
+			}
+			auto distance = std::to_string((unrollFactor_ - 1) * (up ? step : -step));
+			copies = computed;
+			copies.push_back({ "", InstructionType::PUSH, distance });
+			copies.push_back({ "", up ? InstructionType::SUB : InstructionType::ADD, "" });
+			copies.push_back({ "", InstructionType::POP, slot });
+			copies.push_back({ "", InstructionType::PUSH, slot });
+			copies.insert(copies.end(), computed.begin(), computed.end());
+			copies.push_back({ "", up ? InstructionType::CMPLE : InstructionType::CMPGE, "" });
+			copies.push_back({ "", InstructionType::JZ, remainder });
+			copies.push_back({ remainder + suffix, InstructionType::PUSH, counter });
+			copies.push_back({ "", InstructionType::PUSH, slot });
+			copies.push_back({ "", compare, "" });
+			copies.push_back({ "", InstructionType::JZ, remainder });
+			for (size_t c = 1; c <= unrollFactor_; c++) {
+				copy(c, copies);
+			}
+			copies.push_back({ "", InstructionType::JMP, remainder + suffix });
+			unrolledLoops_.insert(heads.begin(), heads.end());
+			unrolledLoops_.insert(remainder + suffix);
+			unrollBudget_ -= size * unrollFactor_;
+		}
+		std::fill(used.begin() + (head - func.begin), used.begin() + (tail - func.begin) + 1, true);
+		auto& inserted = inserts_[head - 1];
+		inserted.insert(inserted.end(), copies.begin(), copies.end());
+		unrolled = true;
+	}
+	if (!declared.empty()) {
+		Declare(code, func, declared);
+	}
+	changed_ = changed_ || unrolled;
+	return unrolled;
+}
+
+void Optimizer::Declare(Code& code, const Func& func, const std::string& declared) {
+	auto var = std::find_if(code.irs.begin() + func.begin, code.irs.begin() + func.end,
+		[](const IntermediateRepresentation& ir) { return ir.instruction == InstructionType::VAR; });
+	if (var != code.irs.begin() + func.end) {
+		var->argument += ", " + declared;
+	} else {
+		// before the IRs inserted after the first IR, e.g. a preheader
+		auto& inserted = inserts_[func.begin];
+		inserted.insert(inserted.begin(), { "", InstructionType::VAR, declared });
+	}
+	changed_ = true;
+}
+
+bool Optimizer::Eliminate(Code& code, const Func& func) {
+	bool eliminated = false;
+	size_t size = func.end - func.begin;
+	// args and locals are declared by their IRs wherever they are
+	for (size_t i = func.begin; i < func.end; i++) {
+		auto type = code.irs[i].instruction;
+		if (!states_[i - func.begin].reached && type != InstructionType::ARG && type != InstructionType::VAR) {
+			Delete(i);
+			eliminated = true;
+		}
+	}
+
+	// locals live before each IR, a frame dies at ret and exit
+	std::vector<std::vector<bool>> lives(size, std::vector<bool>(func.slots.size(), false));
+	std::vector<bool> live;
+	std::vector<size_t> successors;
+	auto use = [&func](const IntermediateRepresentation& ir, std::vector<bool>& live) {
+		auto it = func.slots.find(ir.argument);
+		if (it == func.slots.end()) {
+			return;
+		}
+		if (ir.instruction == InstructionType::POP) {
+			live[it->second] = false;
+		} else if (ir.instruction == InstructionType::PUSH || ir.instruction == InstructionType::RET ||
+			ir.instruction == InstructionType::EXIT) {
+			live[it->second] = true;
+		}
+	};
+	for (bool changed = true; changed;) {
+		changed = false;
+		for (size_t i = func.end; i-- > func.begin;) {
+			if (deleted_[i]) {
+				continue;
+			}
+			live.assign(func.slots.size(), false);
+			Successors(code, func, i, successors);
+			for (auto successor : successors) {
+				const auto& in = lives[successor - func.begin];
+				for (size_t s = 0; s < live.size(); s++) {
+					live[s] = live[s] || in[s];
+				}
+			}
+			use(code.irs[i], live);
+			if (live != lives[i - func.begin]) {
+				lives[i - func.begin] = live;
+				changed = true;
+			}
+		}
+	}
+
+	// a store which is never read only drops the operand
+	for (size_t i = func.begin; i < func.end; i++) {
+		auto& ir = code.irs[i];
+		if (deleted_[i] || ir.instruction != InstructionType::POP || ir.argument.empty()) {
+			continue;
+		}
+		uint32_t slot = func.slots.at(ir.argument);
+		bool read = false;
+		Successors(code, func, i, successors);
+		for (auto successor : successors) {
+			read = read || lives[successor - func.begin][slot];
+		}
+		if (!read) {
+			ir.argument.clear();
+			changed_ = true;
+			eliminated = true;
+		}
+	}
+
+	// an expression of pushes and operators which cannot trap is dropped with its pop.
+	// it must not be entered from a jump in the middle
+	std::vector<bool> targets;
+	Targets(code, func, targets);
+	for (size_t i = func.begin; i < func.end; i++) {
+		if (deleted_[i] || code.irs[i].instruction != InstructionType::POP || !code.irs[i].argument.empty()) {
+			continue;
+		}
+		size_t need = 1;
+		size_t j = i;
+		while (need > 0 && j > func.begin && !targets[j - func.begin]) {
+			j--;
+			const auto& ir = code.irs[j];
+			if (deleted_[j] || !states_[j - func.begin].reached) {
+				break;
+			}
+			if (ir.instruction == InstructionType::PUSH) {
+				need--;
+			} else if (IsBinary(ir.instruction) && ir.instruction != InstructionType::DIV &&
+				ir.instruction != InstructionType::MOD) {
+				need++;
+			} else if (!IsUnary(ir.instruction)) {
+				break;
+			}
+		}
+		if (need > 0) {
+			continue;
+		}
+		for (size_t k = j; k <= i; k++) {
+			Delete(k);
+		}
+		eliminated = true;
+	}
+	return eliminated;
+}
+
+std::string Optimizer::Resolve(const Code& code, const Func& func, const std::string& label) const {
+	std::string resolved = label;
+	size_t target = 0;
+	// a loop of jumps is bounded by the IRs it passes
+	for (size_t hops = 0; hops < func.end - func.begin; hops++) {
+		if (!Target(code, func, resolved, target) || target == code.irs.size() ||
+			code.irs[target].instruction != InstructionType::JMP) {
+			break;
+		}
+		resolved = code.irs[target].argument;
+	}
+	return Target(code, func, resolved, target) ? resolved : label;
+}
+
+bool Optimizer::Thread(Code& code, const Func& func) {
+	bool threaded = false;
+	size_t target = 0;
+	for (size_t i = func.begin; i < func.end; i++) {
+		auto& ir = code.irs[i];
+		if (ir.instruction != InstructionType::JMP && ir.instruction != InstructionType::JZ) {
+			continue;
+		}
+		auto resolved = Resolve(code, func, ir.argument);
+		if (resolved != ir.argument) {
+			ir.argument = resolved;
+			threaded = true;
+		}
+		// jmp to ret or exit runs it in place
+		if (ir.instruction == InstructionType::JMP && Target(code, func, ir.argument, target) &&
+			target != code.irs.size() && (code.irs[target].instruction == InstructionType::RET ||
+			code.irs[target].instruction == InstructionType::EXIT)) {
+			ir.instruction = code.irs[target].instruction;
+			ir.argument = code.irs[target].argument;
+			threaded = true;
+		}
+	}
+
+	std::vector<bool> targets;
+	Targets(code, func, targets);
+	// next IR which is kept
+	auto next = [this, &func](size_t i) {
+		do {
+			i++;
+		} while (i < func.end && deleted_[i]);
+		return i;
+	};
+	for (size_t i = func.begin; i < func.end; i++) {
+		auto& ir = code.irs[i];
+		if (deleted_[i] || (ir.instruction != InstructionType::JMP && ir.instruction != InstructionType::JZ) ||
+			!Target(code, func, ir.argument, target) || target == code.irs.size()) {
+			continue;
+		}
+		size_t n = next(i);
+		if (target == n) {
+			// both ways fall through, jz still drops its condition
+			if (ir.instruction == InstructionType::JMP) {
+				Delete(i);
+			} else {
+				ir.instruction = InstructionType::POP;
+				ir.argument.clear();
+			}
+			threaded = true;
+			continue;
+		}
+
+		// cmp; jz A; jmp B; A: is cmp of the inverse; jz B, so A falls through
+		size_t after = n < func.end ? next(n) : n;
+		if (ir.instruction != InstructionType::JZ || i == func.begin || targets[i - func.begin] ||
+			n == func.end || targets[n - func.begin] || code.irs[n].instruction != InstructionType::JMP ||
+			target != after) {
+			continue;
+		}
+		size_t prev = i - 1;
+		while (prev > func.begin && deleted_[prev]) {
+			prev--;
+		}
+		auto& cond = code.irs[prev];
+		if (deleted_[prev] || !states_[prev - func.begin].reached) {
+			continue;
+		}
+		if (cond.instruction == InstructionType::NOT) {
+			Delete(prev);
+		} else if (Invert(cond.instruction) != InstructionType::NIL) {
+			cond.instruction = Invert(cond.instruction);
+		} else {
+			continue;
+		}
+		ir.argument = code.irs[n].argument;
+		Delete(n);
+		threaded = true;
+	}
+	changed_ = changed_ || threaded;
+	return threaded;
+}
+
+bool Optimizer::TailCall(Code& code, const Func& func) {
+	// the top level code has no caller to return to
+	if (func.name.empty()) {
+		return false;
+	}
+	bool called = false;
+	for (size_t i = func.begin; i + 1 < func.end; i++) {
+		auto& ir = code.irs[i];
+		const auto& next = code.irs[i + 1];
+		// operands under the args are dropped with the frame, as ret does
+		if (ir.instruction == InstructionType::CALL && states_[i - func.begin].reached &&
+			next.instruction == InstructionType::RET && next.argument == "~") {
+			ir.instruction = InstructionType::TAILCALL;
+			called = true;
+		}
+	}
+	changed_ = changed_ || called;
+	return called;
+}
+
+void Optimizer::MergeLabels(Code& code) {
+	// the last label of an IR names it, as the statement which begins there.
+	// the others are renamed to it
+	std::map<std::string, std::string> renames;
+	for (size_t i = 0; i < code.irs.size(); i++) {
+		std::vector<std::string> labels;
+		Utils::Split(code.irs[i].label, ",", labels);
+		std::vector<std::string> merged;
+		for (const auto& label : labels) {
+			auto it = code.labelMap.find(label);
+			if (it != code.labelMap.end() && it->second == i) {
+				merged.push_back(label);
+			}
+		}
+		for (const auto& label : merged) {
+			renames[label] = merged.back();
+		}
+	}
+
+	std::map<std::string, bool> used;
+	for (auto& ir : code.irs) {
+		if (ir.instruction == InstructionType::JMP || ir.instruction == InstructionType::JZ) {
+			auto it = renames.find(ir.argument);
+			if (it != renames.end()) {
+				ir.argument = it->second;
+			}
+			used[ir.argument] = true;
+		}
+	}
+
+	// labels no jump uses are dropped, those of functions stay
+	for (auto it = code.labelMap.begin(); it != code.labelMap.end();) {
+		it = used.count(it->first) == 0 && renames.count(it->first) == 1 ? code.labelMap.erase(it) : std::next(it);
+	}
+	for (auto& ir : code.irs) {
+		std::vector<std::string> labels;
+		Utils::Split(ir.label, ",", labels);
+		std::string label;
+		for (const auto& name : labels) {
+			if (name.empty() || (renames.count(name) == 1 && code.labelMap.count(name) == 0)) {
+				continue;
+			}
+			label = label.empty() ? name : label + "," + name;
+		}
+		ir.label = label;
+	}
+}
+
+void Optimizer::Definite(const Code& code, const Func& func, uint32_t argc, std::vector<std::vector<bool>>& ins) const {
+	// args are assigned by caller
+	ins.assign(func.end - func.begin, {});
+	if (func.begin == func.end) {
+		return;
+	}
+	ins[0].assign(func.slots.size(), false);
+	std::fill(ins[0].begin(), ins[0].begin() + argc, true);
+
+	std::vector<size_t> worklist{ func.begin };
+	std::vector<size_t> successors;
+	while (!worklist.empty()) {
+		size_t i = worklist.back();
+		worklist.pop_back();
+		auto assigned = ins[i - func.begin];
+		const auto& ir = code.irs[i];
+		auto it = func.slots.find(ir.argument);
+		if (it != func.slots.end() && ir.instruction == InstructionType::POP) {
+			assigned[it->second] = true;
+		}
+		Successors(code, func, i, successors);
+		for (auto successor : successors) {
+			auto& in = ins[successor - func.begin];
+			auto merged = assigned;
+			if (!in.empty()) {
+				for (size_t s = 0; s < merged.size(); s++) {
+					merged[s] = merged[s] && in[s];
+				}
+			}
+			if (merged != in) {
+				in = merged;
+				worklist.push_back(successor);
+			}
+		}
+	}
+}
+
+bool Optimizer::Assigned(const Code& code, const Func& func, uint32_t argc) const {
+	std::vector<std::vector<bool>> ins;
+	Definite(code, func, argc, ins);
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& ir = code.irs[i];
+		const auto& assigned = ins[i - func.begin];
+		auto it = func.slots.find(ir.argument);
+		// var x declares x, it does not read it
+		if (assigned.empty() || it == func.slots.end() || ir.instruction == InstructionType::POP ||
+			ir.instruction == InstructionType::ARG || ir.instruction == InstructionType::VAR) {
+			continue;
+		}
+		if (!assigned[it->second]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Optimizer::Inlinable(const Code& code, const Func& func) {
+	if (func.name.empty() || func.end - func.begin > inlineSize_ + 2 || !Propagate(code, func) ||
+		!Assigned(code, func, argcs_[func.name])) {
+		return false;
+	}
+	// ret ~ leaves its value as the only operand of callee
+	for (size_t i = func.begin; i < func.end; i++) {
+		const auto& ir = code.irs[i];
+		const auto& state = states_[i - func.begin];
+		if (!state.reached) {
+			continue;
+		}
+		if ((ir.instruction == InstructionType::RET && state.stack.size() != (ir.argument == "~" ? 1U : 0U)) ||
+			(ir.instruction == InstructionType::TAILCALL && state.stack.size() != argcs_[ir.argument])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Optimizer::Inline(Code& code) {
+	if (!Split(code)) {
+		return false;
+	}
+
+	// call graph, a function which reaches itself is recursive
+	std::map<std::string, size_t> indexes;
+	for (size_t f = 0; f < funcs_.size(); f++) {
+		indexes[funcs_[f].name] = f;
+	}
+	std::vector<std::vector<size_t>> callees(funcs_.size());
+	for (size_t f = 0; f < funcs_.size(); f++) {
+		for (size_t i = funcs_[f].begin; i < funcs_[f].end; i++) {
+			const auto& ir = code.irs[i];
+			if (IsCall(ir.instruction) && indexes.count(ir.argument) == 1) {
+				callees[f].push_back(indexes[ir.argument]);
+			}
+		}
+	}
+	std::vector<bool> inlinable(funcs_.size(), false);
+	std::vector<size_t> sizes(funcs_.size(), 0);
+	for (size_t f = 1; f < funcs_.size(); f++) {
+		std::vector<bool> reached(funcs_.size(), false);
+		std::vector<size_t> worklist = callees[f];
+		while (!worklist.empty()) {
+			size_t g = worklist.back();
+			worklist.pop_back();
+			if (!reached[g]) {
+				reached[g] = true;
+				worklist.insert(worklist.end(), callees[g].begin(), callees[g].end());
+			}
+		}
+		const auto& func = funcs_[f];
+		for (size_t i = func.begin; i < func.end; i++) {
+			auto type = code.irs[i].instruction;
+			sizes[f] += type != InstructionType::ARG && type != InstructionType::VAR ? 1 : 0;
+		}
+		inlinable[f] = !reached[f] && sizes[f] <= inlineSize_ && Inlinable(code, func);
+	}
+
+	// labels of each IR, their names are changed in the copies
+	std::map<uint64_t, std::vector<std::string>> labels;
+	for (const auto& it : code.labelMap) {
+		labels[it.second].push_back(it.first);
+	}
+
+	std::vector<IntermediateRepresentation> irs;
+	std::vector<uint64_t> moved(code.irs.size() + 1, 0);
+	std::map<std::string, uint64_t> added;
+	std::string pending;
+	auto emit = [&irs, &pending](IntermediateRepresentation ir) {
+		if (!pending.empty()) {
+			ir.label = ir.label.empty() ? pending : pending + "," + ir.label;
+			pending.clear();
+		}
+		irs.push_back(std::move(ir));
+	};
+	bool inlined = false;
+	for (size_t f = 0; f < funcs_.size(); f++) {
+		const auto& caller = funcs_[f];
+		for (size_t i = caller.begin; i < caller.end; i++) {
+			moved[i] = irs.size();
+			const auto& ir = code.irs[i];
+			auto it = indexes.find(ir.argument);
+			// the top level code has no frame of its own to take the locals of callee
+			if (f == 0 || ir.instruction != InstructionType::CALL || it == indexes.end() ||
+				!inlinable[it->second] || it->second == f || i + 1 == caller.end ||
+				sizes[it->second] + argcs_[ir.argument] + 1 > inlineBudget_) {
+				emit(ir);
+				continue;
+			}
+			const auto& callee = funcs_[it->second];
+			inlineBudget_ -= sizes[it->second] + argcs_[ir.argument] + 1;
+
+			// names of the copy must not be used in caller
+			std::string suffix;
+			do {
+				suffix = "_inl" + std::to_string(++inlined_);
+			} while (code.labelMap.count("ret" + suffix) == 1 || std::any_of(callee.slots.begin(), callee.slots.end(),
+				[&caller, &suffix](const auto& slot) { return caller.slots.count(slot.first + suffix) == 1; }));
+
+			std::vector<std::string> slots(callee.slots.size());
+			for (const auto& slot : callee.slots) {
+				slots[slot.second] = slot.first + suffix;
+			}
+			std::string declared;
+			for (const auto& slot : slots) {
+				declared = declared.empty() ? slot : declared + ", " + slot;
+			}
+			if (!slots.empty()) {
+				emit({ ir.label, InstructionType::VAR, declared });
+			} else {
+				pending = ir.label;
+			}
+			for (uint32_t a = argcs_[callee.name]; a-- > 0;) {
+				emit({ "", InstructionType::POP, slots[a] });
+			}
+
+			auto rename = [&callee, &suffix](const std::string& name) {
+				return callee.slots.count(name) == 1 ? name + suffix : name;
+			};
+			for (size_t j = callee.begin; j < callee.end; j++) {
+				auto body = code.irs[j];
+				for (const auto& label : labels[j]) {
+					pending = pending.empty() ? label + suffix : pending + "," + label + suffix;
+					added[label + suffix] = irs.size();
+				}
+				if (body.instruction == InstructionType::ARG || body.instruction == InstructionType::VAR) {
+					continue;
+				}
+				body.label.clear();
+				size_t target = 0;
+				if (body.instruction == InstructionType::JMP || body.instruction == InstructionType::JZ) {
+					if (Target(code, callee, body.argument, target) && target != code.irs.size()) {
+						body.argument += suffix;
+					}
+				} else if (body.instruction == InstructionType::TAILCALL) {
+					// the copy is not a frame of its own
+					emit({ "", InstructionType::CALL, body.argument });
+					body = { "", InstructionType::JMP, "ret" + suffix };
+				} else if (body.instruction == InstructionType::RET) {
+					// the value of ret is left on the stack of caller
+					if (body.argument.empty()) {
+						emit({ "", InstructionType::PUSH, "0" });
+					} else if (body.argument != "~") {
+						emit({ "", InstructionType::PUSH, rename(body.argument) });
+					}
+					body = { "", InstructionType::JMP, "ret" + suffix };
+				} else {
+					body.argument = rename(body.argument);
+				}
+				emit(body);
+			}
+			// labels of the callee past its last IR end at ret
+			for (const auto& label : labels[callee.end]) {
+				if (added.count(label + suffix) == 0 && callee.end != code.irs.size()) {
+					added[label + suffix] = irs.size();
+				}
+			}
+			pending = pending.empty() ? "ret" + suffix : pending + ",ret" + suffix;
+			added["ret" + suffix] = irs.size();
+			inlined = true;
+		}
+	}
+	if (!inlined) {
+		return true;
+	}
+	moved[code.irs.size()] = irs.size();
+	code.irs = std::move(irs);
+	for (auto& it : code.labelMap) {
+		it.second = moved[it.second];
+	}
+	for (auto& it : code.funcMap) {
+		it.second = moved[it.second];
+	}
+	code.labelMap.insert(added.begin(), added.end());
+	changed_ = true;
+	return true;
+}
+
+bool Optimizer::Prune(Code& code) {
+	if (!Split(code)) {
+		return false;
+	}
+	std::map<std::string, bool> called;
+	for (const auto& ir : code.irs) {
+		if (IsCall(ir.instruction)) {
+			called[ir.argument] = true;
+		}
+	}
+
+	deleted_.assign(code.irs.size(), false);
+	for (const auto& func : funcs_) {
+		// the code before a function may fall through into it
+		auto last = func.begin == 0 ? InstructionType::NIL : code.irs[func.begin - 1].instruction;
+		if (func.name.empty() || called.count(func.name) == 1 ||
+			(last != InstructionType::RET && last != InstructionType::EXIT && last != InstructionType::JMP)) {
+			continue;
+		}
+		for (size_t i = func.begin; i < func.end; i++) {
+			code.irs[i].label.clear();
+			Delete(i);
+		}
+		for (auto it = code.labelMap.begin(); it != code.labelMap.end();) {
+			it = it->second >= func.begin && it->second < func.end ? code.labelMap.erase(it) : std::next(it);
+		}
+		code.funcMap.erase(func.name);
+	}
+
+	// vars which no IR uses take no slots
+	for (const auto& func : funcs_) {
+		std::map<std::string, bool> used;
+		for (size_t i = func.begin; i < func.end; i++) {
+			used[code.irs[i].argument] = true;
+		}
+		for (size_t i = func.begin; i < func.end; i++) {
+			auto& ir = code.irs[i];
+			if (deleted_[i] || ir.instruction != InstructionType::VAR) {
+				continue;
+			}
+			std::vector<std::string> names;
+			Utils::Split(ir.argument, ",", names);
+			std::string declared;
+			for (const auto& name : names) {
+				if (used.count(name) == 1) {
+					declared = declared.empty() ? name : declared + ", " + name;
+				}
+			}
+			ir.argument = declared;
+			if (declared.empty()) {
+				Delete(i);
+			}
+		}
+	}
+	Compact(code);
+	return true;
+}
+
+bool Optimizer::Layout(Code& code) {
+	if (!Split(code)) {
+		return false;
+	}
+	constexpr size_t npos = static_cast<size_t>(-1);
+	auto falls = [](InstructionType type) {
+		return type != InstructionType::JMP && type != InstructionType::RET && type != InstructionType::EXIT &&
+			type != InstructionType::TAILCALL;
+	};
+
+	std::vector<IntermediateRepresentation> irs;
+	std::vector<uint64_t> moved(code.irs.size() + 1, 0);
+	std::map<std::string, uint64_t> added;
+	for (const auto& func : funcs_) {
+		// blocks are [start, end), a block begins at a target or after a jump
+		std::vector<std::pair<size_t, size_t>> blocks;
+		std::vector<size_t> blockOf(func.end - func.begin, npos);
+		std::vector<bool> targets;
+		Targets(code, func, targets);
+		for (size_t i = func.begin; i < func.end; i++) {
+			if (i == func.begin || targets[i - func.begin] || IsControl(code.irs[i - 1].instruction)) {
+				blocks.push_back({ i, i });
+			}
+			blocks.back().second = i + 1;
+			blockOf[i - func.begin] = blocks.size() - 1;
+		}
+		auto jumped = [&](size_t b) {
+			size_t target = 0;
+			const auto& ir = code.irs[blocks[b].second - 1];
+			return Target(code, func, ir.argument, target) && target != code.irs.size() ?
+				blockOf[target - func.begin] : npos;
+		};
+		// counts of the jz ending block b, by any label of its target
+		auto profiled = [&](size_t b, BranchCount& count) {
+			const auto& ir = code.irs[blocks[b].second - 1];
+			size_t target = jumped(b);
+			if (ir.instruction != InstructionType::JZ || target == npos) {
+				return false;
+			}
+			std::vector<std::string> names;
+			Utils::Split(code.irs[blocks[target].first].label, ",", names);
+			for (const auto& name : names) {
+				auto it = code.branches.find(name);
+				if (it != code.branches.end()) {
+					count = it->second;
+					return true;
+				}
+			}
+			return false;
+		};
+
+		// a function which falls off its end, or has no profile, is kept as it is
+		size_t size = blocks.size();
+		BranchCount count{ 0, 0 };
+		bool laid = func.begin != func.end && !falls(code.irs[func.end - 1].instruction);
+		for (size_t b = 0; laid && b < size && !profiled(b, count); b++) {
+			laid = b + 1 < size;
+		}
+		if (!laid) {
+			for (size_t i = func.begin; i < func.end; i++) {
+				moved[i] = irs.size();
+				irs.push_back(code.irs[i]);
+			}
+			continue;
+		}
+
+		// a chain of blocks falls through from its head, to the side of jz which runs more
+		std::vector<bool> placed(size, false);
+		std::vector<bool> cold(size, false);
+		std::vector<size_t> order;
+		auto place = [&](size_t b) {
+			while (b != npos && !placed[b]) {
+				placed[b] = true;
+				order.push_back(b);
+				auto type = code.irs[blocks[b].second - 1].instruction;
+				size_t next = falls(type) && b + 1 < size ? b + 1 : npos;
+				if (type == InstructionType::JZ && profiled(b, count)) {
+					bool jump = count.taken > count.fallen;
+					size_t other = jump ? next : jumped(b);
+					if (other != npos && std::min(count.taken, count.fallen) * COLD_BRANCH_RATIO <=
+						std::max(count.taken, count.fallen)) {
+						cold[other] = true;
+					}
+					next = jump ? jumped(b) : next;
+				}
+				b = next;
+			}
+		};
+		place(0);
+		for (size_t b = 0; b < size; b++) {
+			if (!cold[b]) {
+				place(b);
+			}
+		}
+		for (size_t b = 0; b < size; b++) {
+			place(b);
+		}
+
+		// a block falls into the next one it is laid before, else jz is inverted or jmp is added
+		std::vector<bool> emitted(size, false);
+		auto labelOf = [&](size_t b) {
+			auto& ir = code.irs[blocks[b].first];
+			std::vector<std::string> names;
+			Utils::Split(ir.label, ",", names);
+			for (const auto& name : names) {
+				auto it = code.labelMap.find(name);
+				if (it != code.labelMap.end() && it->second == blocks[b].first) {
+					return name;
+				}
+			}
+			std::string name;
+			do {
+				name = "_layout" + std::to_string(++laidOut_);
+			} while (code.labelMap.count(name) == 1 || added.count(name) == 1);
+			ir.label = ir.label.empty() ? name : ir.label + "," + name;
+			if (emitted[b]) {
+				irs[moved[blocks[b].first]].label = ir.label;
+			}
+			added[name] = blocks[b].first;
+			return name;
+		};
+		for (size_t k = 0; k < size; k++) {
+			size_t b = order[k];
+			size_t following = k + 1 < size ? order[k + 1] : npos;
+			for (size_t i = blocks[b].first; i + 1 < blocks[b].second; i++) {
+				moved[i] = irs.size();
+				irs.push_back(code.irs[i]);
+			}
+			emitted[b] = true;
+			size_t last = blocks[b].second - 1;
+			auto ir = code.irs[last];
+			size_t next = b + 1 < size ? b + 1 : npos;
+			if (!falls(ir.instruction) || next == following) {
+				moved[last] = irs.size();
+				irs.push_back(ir);
+				continue;
+			}
+			if (ir.instruction == InstructionType::JZ && jumped(b) == following) {
+				// jz to the block after, which is the one laid next
+				bool inner = last > blocks[b].first;
+				moved[last] = irs.size();
+				if (inner && irs.back().instruction == InstructionType::NOT && irs.back().label.empty()) {
+					irs.pop_back();
+					moved[last] = irs.size();
+				} else if (inner && Invert(irs.back().instruction) != InstructionType::NIL) {
+					irs.back().instruction = Invert(irs.back().instruction);
+				} else {
+					// the label of jz stays at the first IR of it
+					irs.push_back({ ir.label, InstructionType::NOT, "" });
+					ir.label.clear();
+				}
+				ir.argument = labelOf(next);
+				irs.push_back(ir);
+				continue;
+			}
+			moved[last] = irs.size();
+			irs.push_back(ir);
+			irs.push_back({ "", InstructionType::JMP, labelOf(next) });
+		}
+	}
+	moved[code.irs.size()] = irs.size();
+	code.irs = std::move(irs);
+	for (auto& it : code.labelMap) {
+		it.second = moved[it.second];
+	}
+	for (auto& it : code.funcMap) {
+		it.second = moved[it.second];
+	}
+	for (const auto& it : added) {
+		code.labelMap[it.first] = moved[it.second];
+	}
+	return true;
+}
+
+void Optimizer::Compact(Code& code) {
+	std::vector<uint64_t> indexes(code.irs.size() + 1, 0);
+	std::vector<IntermediateRepresentation> irs;
+	std::map<std::string, uint64_t> added;
+	std::string label;
+	auto keep = [&irs, &label](IntermediateRepresentation& ir) {
+		if (!ir.label.empty()) {
+			label = label.empty() ? ir.label : label + "," + ir.label;
+		}
+		ir.label = label;
+		label.clear();
+		irs.push_back(std::move(ir));
+	};
+	for (size_t i = 0; i < code.irs.size(); i++) {
+		indexes[i] = irs.size();
+		auto& ir = code.irs[i];
+		if (!deleted_[i]) {
+			keep(ir);
+		} else if (!ir.label.empty() && ir.label != ENDFUNC_LABEL) {
+			// ENDFUNC marks the ret of a function, it does not move to the next function
+			label = label.empty() ? ir.label : label + "," + ir.label;
+		}
+		auto it = inserts_.find(i);
+		if (it != inserts_.end()) {
+			for (auto& inserted : it->second) {
+				std::vector<std::string> names;
+				if (!inserted.label.empty()) {
+					Utils::Split(inserted.label, ",", names);
+				}
+				for (const auto& name : names) {
+					added[name] = irs.size();
+				}
+				keep(inserted);
+			}
+		}
+	}
+	indexes[code.irs.size()] = irs.size();
+	code.irs = std::move(irs);
+	inserts_.clear();
+
+	for (auto& it : code.labelMap) {
+		it.second = indexes[it.second];
+	}
+	for (auto& it : code.funcMap) {
+		it.second = indexes[it.second];
+	}
+	code.labelMap.insert(added.begin(), added.end());
+	deleted_.assign(code.irs.size(), false);
+}
@@ -0,0 +1,239 @@
+/**
+ * @file optimizer.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <map>
+#include <set>
+
+#include "instruction.h"
+
+// rounds of all passes, each round works on the result of the last one
+constexpr uint32_t MAX_OPTIMIZE_ROUNDS = 8;
+// IRs of a function which is inlined, args and vars are not counted
+constexpr size_t DEFAULT_INLINE_SIZE = 16;
+// IRs added by inlining, in percent of the IRs assembled
+constexpr size_t DEFAULT_INLINE_GROWTH = 100;
+// copies of the body of a counted loop per test of its condition
+constexpr uint32_t DEFAULT_UNROLL_FACTOR = 4;
+// IRs of the copies of a body which is unrolled
+constexpr size_t DEFAULT_UNROLL_SIZE = 64;
+// IRs added by unrolling, in percent of the IRs assembled, the size of a loop at least
+constexpr size_t DEFAULT_UNROLL_GROWTH = 50;
+// a loop of a constant trip count up to it is unrolled fully
+constexpr var MAX_UNROLL_TRIPS = 16;
+// a side of jz which runs once in this many runs of the other side goes to the end of function
+constexpr uint64_t COLD_BRANCH_RATIO = 16;
+
+// Passes over the IRs of Assembler, between Assemble and Encode.
+// An IR is rewritten in place or deleted, the labels of a deleted IR move to
+// the next IR which is kept, so labelMap and funcMap follow the IRs.
+// A function is analyzed on its own from its entry, one which cannot be
+// analyzed (e.g. the stack depths differ at a label) is left as it is.
+class Optimizer {
+public:
+    // constant folding and constant propagation
+    inline void SetFold(bool fold) {
+        fold_ = fold;
+    }
+
+    // mul, div and mod by 2^k are shifts, and identities as x + 0, x * 1, !!x or cmpne 0 feeding jz
+    // are removed
+    inline void SetReduce(bool reduce) {
+        reduce_ = reduce;
+    }
+
+    // an expression which is computed again while its locals are unchanged on every path
+    // is reused from a hidden local, which its first computations store
+    inline void SetReuse(bool reuse) {
+        reuse_ = reuse;
+    }
+
+    // expressions of a while loop whose locals the loop does not assign are computed once
+    // before it into hidden locals
+    inline void SetHoist(bool hoist) {
+        hoist_ = hoist;
+    }
+
+    // a while loop which counts a local by a constant step runs factor copies of its body per test,
+    // the iterations left run in the loop as it is. a loop of a few constant trips is unrolled fully
+    inline void SetUnroll(bool unroll) {
+        unroll_ = unroll;
+    }
+
+    inline void SetUnrollBudget(uint32_t factor, size_t size, size_t growth) {
+        unrollFactor_ = factor;
+        unrollSize_ = size;
+        unrollGrowth_ = growth;
+    }
+
+    // unreachable IRs, stores never read and expressions whose values are dropped
+    inline void SetDeadCode(bool deadCode) {
+        deadCode_ = deadCode;
+    }
+
+    // jump chains, jumps to the next IR and jz over a jmp, labels of an IR are merged
+    inline void SetThread(bool thread) {
+        thread_ = thread;
+    }
+
+    // small functions which are not recursive are copied into their callers,
+    // a function which is no longer called is removed
+    inline void SetInline(bool inlining) {
+        inline_ = inlining;
+    }
+
+    inline void SetInlineBudget(size_t size, size_t growth) {
+        inlineSize_ = size;
+        inlineGrowth_ = growth;
+    }
+
+    // call f; ret ~ of a function is a tail call, which runs in the frame of caller
+    inline void SetTailCall(bool tailCall) {
+        tailCall_ = tailCall;
+    }
+
+    // false if the functions of code cannot be split, code may be partly optimized then.
+    // blocks are laid out by the branches of code if it has a profile
+    bool Optimize(Code& code);
+
+private:
+    // value of a local or an operand in constant propagation
+    struct Value {
+        enum Kind : uint8_t {
+            UNDEF,
+            CONST,
+            VARYING
+        } kind;
+        var imm;
+    };
+
+    // values before an IR, reached is false until a path from entry is found
+    struct State {
+        bool reached{ false };
+        std::vector<Value> locals;
+        std::vector<Value> stack;
+    };
+
+    // IRs of a function are [begin, end), the top level code has no name
+    struct Func {
+        std::string name;
+        size_t begin;
+        size_t end;
+        std::map<std::string, uint32_t> slots;
+    };
+
+    // expression of a block on the stack, whose IRs are [start, the IR of its root].
+    // key is of its operators and operands, start is npos if it is not one
+    struct Tree {
+        size_t start;
+        std::string key;
+        std::vector<std::string> locals;
+        size_t cost;
+        // a div or mod by an operand which may be 0 or -1
+        bool traps;
+    };
+
+    // a pass over the IRs of an analyzed function, true if it changed them
+    using Pass = bool (Optimizer::*)(Code& code, const Func& func);
+    bool Run(Code& code, Pass pass);
+
+    bool Split(const Code& code);
+    // index of the IR at label, irs.size() halts. false if it is out of func
+    bool Target(const Code& code, const Func& func, const std::string& label, size_t& target) const;
+    bool Successors(const Code& code, const Func& func, size_t i, std::vector<size_t>& successors) const;
+    // IRs of func which are jumped to, paths merge there
+    void Targets(const Code& code, const Func& func, std::vector<bool>& targets) const;
+
+    // values of locals and operands at each IR of func in states_
+    bool Propagate(const Code& code, const Func& func);
+    bool Transfer(const IntermediateRepresentation& ir, const Func& func, State& state) const;
+    static bool Merge(State& into, const State& from, bool& changed);
+    // locals of known values are replaced by immediates
+    bool Substitute(Code& code, const Func& func);
+    // operators of immediates pushed in the same block are folded, after Substitute
+    bool Fold(Code& code, const Func& func);
+    // strength reduction and algebraic identities in a block
+    bool Reduce(Code& code, const Func& func);
+    // expression trees of func by the IR of their roots
+    void Trees(const Code& code, const Func& func, std::vector<Tree>& trees);
+    // value numbering of expressions by their operators and locals, available ones are reused
+    bool Reuse(Code& code, const Func& func);
+    // a loop is [head, the last jump back to it], nothing out of it jumps into it
+    bool Entered(const Code& code, const Func& func, size_t head, size_t tail) const;
+    // the loops of func, inner ones first
+    void Loops(const Code& code, const Func& func, std::vector<std::pair<size_t, size_t>>& loops) const;
+    bool Hoist(Code& code, const Func& func);
+    bool Unroll(Code& code, const Func& func);
+    // hidden locals join the vars of func
+    void Declare(Code& code, const Func& func, const std::string& declared);
+    bool Eliminate(Code& code, const Func& func);
+    // the label a chain of jumps from label ends at
+    std::string Resolve(const Code& code, const Func& func, const std::string& label) const;
+    bool Thread(Code& code, const Func& func);
+    void MergeLabels(Code& code);
+    bool TailCall(Code& code, const Func& func);
+
+    // locals assigned before each IR of func on all paths, empty if it is not reached
+    void Definite(const Code& code, const Func& func, uint32_t argc, std::vector<std::vector<bool>>& ins) const;
+    // every local read by func is assigned before on all paths
+    bool Assigned(const Code& code, const Func& func, uint32_t argc) const;
+    bool Inlinable(const Code& code, const Func& func);
+    // calls are replaced by copies of callee, whose locals and labels are renamed by a suffix
+    bool Inline(Code& code);
+    // functions which are not called and vars which are not used
+    bool Prune(Code& code);
+    // the side of a profiled jz which runs more falls through, and a cold side moves to the end.
+    // other blocks keep their order
+    bool Layout(Code& code);
+
+    inline void Delete(size_t i) {
+        deleted_[i] = true;
+        changed_ = true;
+    }
+    // drop the deleted IRs and move their labels, IRs inserted after an IR follow it and
+    // their labels are added
+    void Compact(Code& code);
+
+    bool fold_{ true };
+    bool reduce_{ true };
+    bool reuse_{ true };
+    bool hoist_{ true };
+    bool unroll_{ true };
+    bool deadCode_{ true };
+    bool thread_{ true };
+    bool tailCall_{ true };
+    bool inline_{ true };
+    size_t inlineSize_{ DEFAULT_INLINE_SIZE };
+    size_t inlineGrowth_{ DEFAULT_INLINE_GROWTH };
+    size_t inlineBudget_{ 0 };
+    uint32_t unrollFactor_{ DEFAULT_UNROLL_FACTOR };
+    size_t unrollSize_{ DEFAULT_UNROLL_SIZE };
+    size_t unrollGrowth_{ DEFAULT_UNROLL_GROWTH };
+    size_t unrollBudget_{ 0 };
+    uint32_t inlined_{ 0 };
+    uint32_t reused_{ 0 };
+    uint32_t hoisted_{ 0 };
+    uint32_t unrolled_{ 0 };
+    uint32_t laidOut_{ 0 };
+
+    std::vector<Func> funcs_;
+    std::map<std::string, uint32_t> argcs_;
+    std::vector<State> states_;
+    std::vector<bool> deleted_;
+    std::map<size_t, std::vector<IntermediateRepresentation>> inserts_;
+    // labels of the loops unrolled, a loop left for the rest of iterations is not unrolled again
+    std::set<std::string> unrolledLoops_;
+    bool changed_{ false };
+};
+
+#endif
@@ -0,0 +1,781 @@
+/**
+ * @file regvm.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "regvm.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+
+static const char* const regOpStrs[] = {
+	"", "add", "sub", "mul", "div", "mod", "and", "or", "bitand", "bitor", "bitxor",
+	"cmpeq", "cmpne", "cmpgt", "cmplt", "cmpge", "cmple",
+	"addi", "subi", "muli", "divi", "modi", "andi", "ori", "bitandi", "bitori", "bitxori",
+	"cmpeqi", "cmpnei", "cmpgti", "cmplti", "cmpgei", "cmplei",
+	"neg", "not", "shli", "shri", "maski", "mov", "movi", "jmp", "jz",
+	"breq", "brne", "brgt", "brlt", "brge", "brle",
+	"breqi", "brnei", "brgti", "brlti", "brgei", "brlei",
+	"call", "tailcall", "ret", "reti", "retv", "exit", "exiti", "exitv", "halt"
+};
+static_assert(sizeof(regOpStrs) / sizeof(regOpStrs[0]) == static_cast<size_t>(RegOp::MAX));
+
+// binary operators of stack code, in the order of RegOp::ADD ~ RegOp::CMPLE
+static const OpCode binaryOps[] = {
+	OpCode::ADD, OpCode::SUB, OpCode::MUL, OpCode::DIV, OpCode::MOD,
+	OpCode::AND, OpCode::OR, OpCode::BITAND, OpCode::BITOR, OpCode::BITXOR,
+	OpCode::CMPEQ, OpCode::CMPNE, OpCode::CMPGT, OpCode::CMPLT, OpCode::CMPGE, OpCode::CMPLE
+};
+
+static RegOp GetBinaryOp(OpCode op, bool imm) {
+	for (size_t i = 0; i < sizeof(binaryOps) / sizeof(binaryOps[0]); i++) {
+		if (binaryOps[i] == op) {
+			return static_cast<RegOp>(static_cast<size_t>(imm ? RegOp::ADDI : RegOp::ADD) + i);
+		}
+	}
+	return RegOp::NIL;
+}
+
+static bool IsJump(RegOp op) {
+	return op == RegOp::JMP || op == RegOp::JZ || (op >= RegOp::BREQ && op <= RegOp::BRLEI);
+}
+
+void RegProgram::Print() const {
+	std::cout << "RegCodes:" << std::endl;
+	for (size_t i = 0; i < code.size(); i++) {
+		auto it = labels.find(i);
+		const auto& rc = code[i];
+		std::cout << "\t" << i << ": " <<
+			(it == labels.end() ? "" : it->second) << "\t" <<
+			regOpStrs[static_cast<size_t>(rc.op)] << "\t" <<
+			rc.dst << "\t" << rc.a << "\t" << rc.b << "\t" << rc.imm << std::endl;
+	}
+
+	std::cout << "RegFuncs:" << std::endl;
+	for (const auto& it : funcs) {
+		std::cout << "\t" << it.name << ": entry " << it.entry << ", argc " << it.argc <<
+			", varc " << it.varc << ", registers " << it.size << std::endl;
+	}
+}
+
+bool RegVm::Translate(const Program& program) {
+	program_.Clear();
+	if (!program.verified) {
+		std::cerr << "[err]: Register code needs a verified program." << std::endl;
+		return false;
+	}
+
+	program_.indexes.assign(program.code.size(), UINT64_MAX);
+	for (uint32_t f = 0; f < program.funcs.size(); f++) {
+		if (!TranslateFunc(program, f)) {
+			return false;
+		}
+	}
+	// halt of stack code
+	program_.indexes.back() = program_.code.size();
+	Emit(RegOp::HALT, 0, 0, 0, 0LL);
+
+	// jumps are emitted with the ip of stack code
+	for (auto& rc : program_.code) {
+		if (IsJump(rc.op)) {
+			rc.dst = static_cast<uint32_t>(program_.indexes[rc.dst]);
+		}
+	}
+	for (const auto& it : program.labels) {
+		if (program_.indexes[it.first] != UINT64_MAX) {
+			program_.labels[program_.indexes[it.first]] = it.second;
+		}
+	}
+	return true;
+}
+
+// stack depth before each instruction, -1 if unreachable
+bool RegVm::Depths(const Program& program, const FuncInfo& func) {
+	depths_.assign(func.end - func.entry, -1);
+	targets_.assign(func.end - func.entry, false);
+	if (func.entry == func.end) {
+		return true;
+	}
+
+	std::vector<uint64_t> worklist{ func.entry };
+	depths_[0] = 0;
+	targets_[0] = true;
+	auto flow = [&](uint64_t to, int64_t depth, bool jump) {
+		if (to < func.entry || to >= func.end) {
+			// only halt is out of the function
+			return;
+		}
+		if (jump) {
+			targets_[to - func.entry] = true;
+		}
+		if (depths_[to - func.entry] < 0) {
+			depths_[to - func.entry] = depth;
+			worklist.push_back(to);
+		}
+	};
+	while (!worklist.empty()) {
+		uint64_t ip = worklist.back();
+		worklist.pop_back();
+		const auto& bc = program.code[ip];
+		int64_t depth = depths_[ip - func.entry];
+		bool fallThrough = true;
+		switch (bc.op) {
+		case OpCode::PUSHI:
+		case OpCode::PUSHL:
+			depth += 1;
+			break;
+		case OpCode::PUSHLL:
+			depth += 2;
+			break;
+		case OpCode::NEG:
+		case OpCode::NOT:
+		case OpCode::INCL:
+		case OpCode::MOVL:
+		case OpCode::MOVI:
+		case OpCode::ADDI:
+		case OpCode::SUBI:
+		case OpCode::MULI:
+		case OpCode::DIVI:
+		case OpCode::MODI:
+		case OpCode::SHLI:
+		case OpCode::SHRI:
+		case OpCode::MASKI:
+			break;
+		case OpCode::POPL:
+		case OpCode::POP:
+			depth -= 1;
+			break;
+		case OpCode::JMP:
+			flow(bc.a, depth, true);
+			fallThrough = false;
+			break;
+		case OpCode::JZ:
+			depth -= 1;
+			flow(bc.a, depth, true);
+			break;
+		case OpCode::JZEQLI:
+		case OpCode::JZNELI:
+		case OpCode::JZGTLI:
+		case OpCode::JZLTLI:
+		case OpCode::JZGELI:
+		case OpCode::JZLELI:
+			flow(bc.a, depth, true);
+			break;
+		case OpCode::CALL:
+			depth += 1 - static_cast<int64_t>(program.funcs[bc.a].argc);
+			break;
+		case OpCode::TAILCALL:
+		case OpCode::RET:
+		case OpCode::RETV:
+		case OpCode::EXIT:
+		case OpCode::EXITV:
+		case OpCode::HALT:
+			fallThrough = false;
+			break;
+		default:
+			if (GetBinaryOp(bc.op, false) == RegOp::NIL) {
+				std::cerr << "[err]: Register code does not support " <<
+					opCodeInfos[static_cast<size_t>(bc.op)].str << std::endl;
+				return false;
+			}
+			depth -= 1;
+			break;
+		}
+		if (fallThrough) {
+			flow(ip + 1, depth, false);
+		}
+	}
+	return true;
+}
+
+bool RegVm::TranslateFunc(const Program& program, uint32_t funcIdx) {
+	const auto& func = program.funcs[funcIdx];
+	slots_ = func.argc + func.varc;
+	program_.funcs.push_back({ func.name, program_.code.size(), func.argc, func.varc, slots_ + func.maxStack });
+	if (!Depths(program, func)) {
+		return false;
+	}
+
+	stack_.clear();
+	lastDef_ = UINT64_MAX;
+	bool fallThrough = false;
+	for (uint64_t ip = func.entry; ip < func.end; ip++) {
+		int64_t depth = depths_[ip - func.entry];
+		if (depth < 0) {
+			continue;
+		}
+		if (targets_[ip - func.entry]) {
+			// values flow into a block in their temps
+			if (fallThrough) {
+				Flush();
+			}
+			stack_.clear();
+			for (int64_t d = 0; d < depth; d++) {
+				stack_.push_back({ false, Temp(d), 0LL });
+			}
+			lastDef_ = UINT64_MAX;
+		}
+		program_.indexes[ip] = program_.code.size();
+		fallThrough = true;
+
+		const auto& bc = program.code[ip];
+		auto pop = [this]() {
+			Operand operand = stack_.back();
+			stack_.pop_back();
+			return operand;
+		};
+		switch (bc.op) {
+		case OpCode::PUSHI:
+			stack_.push_back({ true, 0, bc.b });
+			break;
+		case OpCode::PUSHL:
+			stack_.push_back({ false, bc.a, 0LL });
+			break;
+		case OpCode::PUSHLL:
+			stack_.push_back({ false, bc.a, 0LL });
+			stack_.push_back({ false, bc.c, 0LL });
+			break;
+		case OpCode::POPL:
+			Assign(bc.a, pop());
+			break;
+		case OpCode::POP:
+			pop();
+			break;
+		case OpCode::INCL:
+			Alias(bc.a);
+			Emit(RegOp::ADDI, bc.a, bc.a, 0, bc.b);
+			break;
+		case OpCode::MOVL:
+			Assign(bc.a, { false, bc.c, 0LL });
+			break;
+		case OpCode::MOVI:
+			Assign(bc.a, { true, 0, bc.b });
+			break;
+		case OpCode::NEG:
+		case OpCode::NOT: {
+			Operand operand = pop();
+			uint32_t dst = Temp(stack_.size());
+			if (operand.imm) {
+				Emit(RegOp::MOVI, dst, 0, 0, operand.value);
+				operand = { false, dst, 0LL };
+			}
+			Emit(bc.op == OpCode::NEG ? RegOp::NEG : RegOp::NOT, dst, operand.reg, 0, 0LL);
+			stack_.push_back({ false, dst, 0LL });
+			lastDef_ = program_.code.size() - 1;
+			break;
+		}
+		case OpCode::SHLI:
+		case OpCode::SHRI:
+		case OpCode::MASKI: {
+			Operand operand = pop();
+			uint32_t dst = Temp(stack_.size());
+			if (operand.imm) {
+				Emit(RegOp::MOVI, dst, 0, 0, operand.value);
+				operand = { false, dst, 0LL };
+			}
+			Emit(static_cast<RegOp>(static_cast<size_t>(RegOp::SHLI) + static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::SHLI)),
+				dst, operand.reg, 0, bc.b);
+			stack_.push_back({ false, dst, 0LL });
+			lastDef_ = program_.code.size() - 1;
+			break;
+		}
+		case OpCode::ADDI:
+		case OpCode::SUBI:
+		case OpCode::MULI:
+		case OpCode::DIVI:
+		case OpCode::MODI: {
+			static const OpCode ops[] = { OpCode::ADD, OpCode::SUB, OpCode::MUL, OpCode::DIV, OpCode::MOD };
+			Operand left = pop();
+			Binary(ops[static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::ADDI)], left, { true, 0, bc.b });
+			break;
+		}
+		case OpCode::JMP:
+			Flush();
+			Emit(RegOp::JMP, bc.a, 0, 0, 0LL);
+			fallThrough = false;
+			break;
+		case OpCode::JZ: {
+			Operand cond = pop();
+			const RegCode* last = program_.code.empty() ? nullptr : &program_.code.back();
+			if (!cond.imm && lastDef_ == program_.code.size() - 1 && cond.reg == last->dst &&
+				last->op >= RegOp::CMPEQ && last->op <= RegOp::CMPLEI &&
+				(last->op <= RegOp::CMPLE || last->op >= RegOp::CMPEQI)) {
+				// cmpxx; jz is one branch, the compare only feeds it
+				RegCode cmp = *last;
+				program_.code.pop_back();
+				Flush();
+				RegOp op = cmp.op <= RegOp::CMPLE ?
+					static_cast<RegOp>(static_cast<size_t>(RegOp::BREQ) + static_cast<size_t>(cmp.op) - static_cast<size_t>(RegOp::CMPEQ)) :
+					static_cast<RegOp>(static_cast<size_t>(RegOp::BREQI) + static_cast<size_t>(cmp.op) - static_cast<size_t>(RegOp::CMPEQI));
+				Emit(op, bc.a, cmp.a, cmp.b, cmp.imm);
+			} else if (cond.imm) {
+				Flush();
+				if (cond.value == 0LL) {
+					Emit(RegOp::JMP, bc.a, 0, 0, 0LL);
+				}
+			} else {
+				Flush();
+				Emit(RegOp::JZ, bc.a, cond.reg, 0, 0LL);
+			}
+			break;
+		}
+		case OpCode::JZEQLI:
+		case OpCode::JZNELI:
+		case OpCode::JZGTLI:
+		case OpCode::JZLTLI:
+		case OpCode::JZGELI:
+		case OpCode::JZLELI:
+			Flush();
+			Emit(static_cast<RegOp>(static_cast<size_t>(RegOp::BREQI) + static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::JZEQLI)),
+				bc.a, bc.c, 0, bc.b);
+			break;
+		case OpCode::CALL: {
+			// args are passed in their temps, and the return value replaces them
+			Flush();
+			size_t base = stack_.size() - program.funcs[bc.a].argc;
+			Emit(RegOp::CALL, 0, Temp(base), bc.a, 0LL);
+			stack_.resize(base);
+			stack_.push_back({ false, Temp(base), 0LL });
+			break;
+		}
+		case OpCode::TAILCALL: {
+			Flush();
+			size_t base = stack_.size() - program.funcs[bc.a].argc;
+			Emit(RegOp::TAILCALL, 0, Temp(base), bc.a, 0LL);
+			fallThrough = false;
+			break;
+		}
+		case OpCode::RET:
+		case OpCode::EXIT: {
+			Operand operand = pop();
+			bool isRet = bc.op == OpCode::RET;
+			if (operand.imm) {
+				Emit(isRet ? RegOp::RETI : RegOp::EXITI, 0, 0, 0, operand.value);
+			} else {
+				Emit(isRet ? RegOp::RET : RegOp::EXIT, 0, operand.reg, 0, 0LL);
+			}
+			fallThrough = false;
+			break;
+		}
+		case OpCode::RETV:
+		case OpCode::EXITV:
+		case OpCode::HALT:
+			Emit(bc.op == OpCode::RETV ? RegOp::RETV : bc.op == OpCode::EXITV ? RegOp::EXITV : RegOp::HALT,
+				0, 0, 0, 0LL);
+			fallThrough = false;
+			break;
+		default: {
+			Operand right = pop();
+			Operand left = pop();
+			Binary(bc.op, left, right);
+			break;
+		}
+		}
+	}
+	if (fallThrough) {
+		// the only way out of a function by falling is halt
+		Flush();
+		Emit(RegOp::JMP, static_cast<uint32_t>(program.code.size() - 1), 0, 0, 0LL);
+	}
+	return true;
+}
+
+void RegVm::Emit(RegOp op, uint32_t dst, uint32_t a, uint32_t b, var imm) {
+	program_.code.push_back({ op, dst, a, b, imm });
+}
+
+uint32_t RegVm::Temp(size_t depth) const {
+	return slots_ + static_cast<uint32_t>(depth);
+}
+
+void RegVm::Materialize(size_t depth) {
+	auto& operand = stack_[depth];
+	if (operand.imm) {
+		Emit(RegOp::MOVI, Temp(depth), 0, 0, operand.value);
+	} else {
+		Emit(RegOp::MOV, Temp(depth), operand.reg, 0, 0LL);
+	}
+	operand = { false, Temp(depth), 0LL };
+}
+
+void RegVm::Flush() {
+	for (size_t d = 0; d < stack_.size(); d++) {
+		if (stack_[d].imm || stack_[d].reg != Temp(d)) {
+			Materialize(d);
+		}
+	}
+}
+
+bool RegVm::Alias(uint32_t slot) {
+	bool aliased = false;
+	for (size_t d = 0; d < stack_.size(); d++) {
+		if (!stack_[d].imm && stack_[d].reg == slot) {
+			Materialize(d);
+			aliased = true;
+		}
+	}
+	return aliased;
+}
+
+void RegVm::Binary(OpCode op, Operand left, Operand right) {
+	uint32_t dst = Temp(stack_.size());
+	if (left.imm && !right.imm) {
+		switch (op) {
+		case OpCode::ADD:
+		case OpCode::MUL:
+		case OpCode::AND:
+		case OpCode::OR:
+		case OpCode::BITAND:
+		case OpCode::BITOR:
+		case OpCode::BITXOR:
+		case OpCode::CMPEQ:
+		case OpCode::CMPNE:
+			std::swap(left, right);
+			break;
+		case OpCode::CMPGT: std::swap(left, right); op = OpCode::CMPLT; break;
+		case OpCode::CMPLT: std::swap(left, right); op = OpCode::CMPGT; break;
+		case OpCode::CMPGE: std::swap(left, right); op = OpCode::CMPLE; break;
+		case OpCode::CMPLE: std::swap(left, right); op = OpCode::CMPGE; break;
+		default:
+			break;
+		}
+	}
+	if (left.imm) {
+		Emit(RegOp::MOVI, dst, 0, 0, left.value);
+		left = { false, dst, 0LL };
+	}
+	if (right.imm && (op == OpCode::DIV || op == OpCode::MOD) && (right.value == 0LL || right.value == -1LL)) {
+		// divided by zero or overflow is found by the register form at run time
+		Emit(RegOp::MOVI, dst + 1, 0, 0, right.value);
+		right = { false, dst + 1, 0LL };
+	}
+
+	if (right.imm) {
+		Emit(GetBinaryOp(op, true), dst, left.reg, 0, right.value);
+	} else {
+		Emit(GetBinaryOp(op, false), dst, left.reg, right.reg, 0LL);
+	}
+	stack_.push_back({ false, dst, 0LL });
+	lastDef_ = program_.code.size() - 1;
+}
+
+void RegVm::Assign(uint32_t slot, const Operand& value) {
+	bool aliased = Alias(slot);
+	if (!value.imm && value.reg == slot) {
+		return;
+	}
+	if (!aliased && !value.imm && value.reg >= slots_ &&
+		lastDef_ == program_.code.size() - 1 && program_.code.back().dst == value.reg) {
+		// the temp is only the result of last instruction, write it to the local directly
+		program_.code.back().dst = slot;
+		lastDef_ = UINT64_MAX;
+		return;
+	}
+	if (value.imm) {
+		Emit(RegOp::MOVI, slot, 0, 0, value.value);
+	} else {
+		Emit(RegOp::MOV, slot, value.reg, 0, 0LL);
+	}
+}
+
+bool RegVm::Run(Cpu& cpu, Tracer* tracer, var& ret) {
+	if (program_.funcs.empty() || program_.funcs[0].size > cpu.stack.size()) {
+		std::cerr << "[err]: Stack overflow." << std::endl;
+		return false;
+	}
+	var value = 0LL;
+	Leave leave = Leave::HALT;
+	bool ok = tracer != nullptr && tracer->IsStats() ?
+		Exec<true>(cpu, tracer, program_.funcs[0].entry, 0, 0, value, leave) :
+		Exec<false>(cpu, tracer, program_.funcs[0].entry, 0, 0, value, leave);
+	if (ok && leave != Leave::HALT) {
+		ret = value;
+	}
+	return ok;
+}
+
+bool RegVm::Enter(Cpu& cpu, uint64_t ip, uint64_t bp, uint64_t fp, var& value, Leave& leave) {
+	return Exec<false>(cpu, nullptr, ip, bp, fp, value, leave);
+}
+
+template <bool kCount>
+bool RegVm::Exec(Cpu& cpu, Tracer* tracer, uint64_t ip, uint64_t bp0, uint64_t fp0, var& value, Leave& leave) {
+	const RegCode* const code = program_.code.data();
+	const RegFunc* const funcs = program_.funcs.data();
+	var* const stack = cpu.stack.data();
+	var* const limit = stack + cpu.stack.size();
+	Frame* const frames = cpu.frames.data();
+	Frame* const frameLimit = frames + cpu.frames.size();
+
+	const RegCode* pc = code + ip;
+	var* bp = stack + bp0;
+	// frame which returns out of register code
+	Frame* const base = frames + fp0;
+	Frame* fp = base;
+	const char* err = nullptr;
+	[[maybe_unused]] uint64_t count = 0;
+
+#define R(r) bp[r]
+#define FAIL(msg) do { err = (msg); goto fail; } while (0)
+
+#if HYS_COMPUTED_GOTO
+	static const void* const labels[] = {
+		&&L_NIL, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD,
+		&&L_AND, &&L_OR, &&L_BITAND, &&L_BITOR, &&L_BITXOR,
+		&&L_CMPEQ, &&L_CMPNE, &&L_CMPGT, &&L_CMPLT, &&L_CMPGE, &&L_CMPLE,
+		&&L_ADDI, &&L_SUBI, &&L_MULI, &&L_DIVI, &&L_MODI,
+		&&L_ANDI, &&L_ORI, &&L_BITANDI, &&L_BITORI, &&L_BITXORI,
+		&&L_CMPEQI, &&L_CMPNEI, &&L_CMPGTI, &&L_CMPLTI, &&L_CMPGEI, &&L_CMPLEI,
+		&&L_NEG, &&L_NOT, &&L_SHLI, &&L_SHRI, &&L_MASKI, &&L_MOV, &&L_MOVI, &&L_JMP, &&L_JZ,
+		&&L_BREQ, &&L_BRNE, &&L_BRGT, &&L_BRLT, &&L_BRGE, &&L_BRLE,
+		&&L_BREQI, &&L_BRNEI, &&L_BRGTI, &&L_BRLTI, &&L_BRGEI, &&L_BRLEI,
+		&&L_CALL, &&L_TAILCALL, &&L_RET, &&L_RETI, &&L_RETV, &&L_EXIT, &&L_EXITI, &&L_EXITV, &&L_HALT
+	};
+	static_assert(sizeof(labels) / sizeof(labels[0]) == static_cast<size_t>(RegOp::MAX));
+#define DISPATCH() do { \
+	if constexpr (kCount) { \
+		++count; \
+	} \
+	goto *labels[static_cast<size_t>(pc->op)]; \
+} while (0)
+#define HANDLER(op) L_##op
+#else
+#define DISPATCH() do { \
+	if constexpr (kCount) { \
+		++count; \
+	} \
+	goto dispatch; \
+} while (0)
+#define HANDLER(op) case RegOp::op
+#endif
+#define NEXT() do { ++pc; DISPATCH(); } while (0)
+
+#define BINARY(op, expr) \
+	HANDLER(op): { \
+		const var left = R(pc->a); \
+		const var right = R(pc->b); \
+		R(pc->dst) = (expr); \
+		NEXT(); \
+	} \
+	HANDLER(op##I): { \
+		const var left = R(pc->a); \
+		const var right = pc->imm; \
+		R(pc->dst) = (expr); \
+		NEXT(); \
+	}
+
+#define BRANCH(op, cmp) \
+	HANDLER(op): { \
+		pc = R(pc->a) cmp R(pc->b) ? pc + 1 : code + pc->dst; \
+		DISPATCH(); \
+	} \
+	HANDLER(op##I): { \
+		pc = R(pc->a) cmp pc->imm ? pc + 1 : code + pc->dst; \
+		DISPATCH(); \
+	}
+
+	DISPATCH();
+
+#if !HYS_COMPUTED_GOTO
+dispatch:
+	switch (pc->op) {
+#endif
+
+	BINARY(ADD, WrapAdd(left, right))
+	BINARY(SUB, WrapSub(left, right))
+	BINARY(MUL, WrapMul(left, right))
+	BINARY(AND, left && right)
+	BINARY(OR, left || right)
+	BINARY(BITAND, left & right)
+	BINARY(BITOR, left | right)
+	BINARY(BITXOR, left ^ right)
+	BINARY(CMPEQ, left == right)
+	BINARY(CMPNE, left != right)
+	BINARY(CMPGT, left > right)
+	BINARY(CMPLT, left < right)
+	BINARY(CMPGE, left >= right)
+	BINARY(CMPLE, left <= right)
+
+	// immediate divisor is never 0 or -1, translator keeps it in a register
+	HANDLER(DIV): {
+		if (R(pc->b) == 0LL) {
+			FAIL("Div: divided by zero.");
+		}
+		if (IsOverflow(R(pc->a), R(pc->b))) {
+			FAIL("Div: overflow.");
+		}
+		R(pc->dst) = R(pc->a) / R(pc->b);
+		NEXT();
+	}
+	HANDLER(MOD): {
+		if (R(pc->b) == 0LL) {
+			FAIL("Mod: divided by zero.");
+		}
+		if (IsOverflow(R(pc->a), R(pc->b))) {
+			FAIL("Mod: overflow.");
+		}
+		R(pc->dst) = R(pc->a) % R(pc->b);
+		NEXT();
+	}
+	HANDLER(DIVI): {
+		R(pc->dst) = R(pc->a) / pc->imm;
+		NEXT();
+	}
+	HANDLER(MODI): {
+		R(pc->dst) = R(pc->a) % pc->imm;
+		NEXT();
+	}
+
+	HANDLER(NEG): {
+		R(pc->dst) = WrapSub(0LL, R(pc->a));
+		NEXT();
+	}
+	HANDLER(NOT): {
+		R(pc->dst) = !R(pc->a);
+		NEXT();
+	}
+	HANDLER(SHLI): {
+		R(pc->dst) = ShiftLeft(R(pc->a), pc->imm);
+		NEXT();
+	}
+	HANDLER(SHRI): {
+		R(pc->dst) = ShiftRight(R(pc->a), pc->imm);
+		NEXT();
+	}
+	HANDLER(MASKI): {
+		R(pc->dst) = Mask(R(pc->a), pc->imm);
+		NEXT();
+	}
+	HANDLER(MOV): {
+		R(pc->dst) = R(pc->a);
+		NEXT();
+	}
+	HANDLER(MOVI): {
+		R(pc->dst) = pc->imm;
+		NEXT();
+	}
+
+	HANDLER(JMP): {
+		pc = code + pc->dst;
+		DISPATCH();
+	}
+	HANDLER(JZ): {
+		pc = R(pc->a) == 0LL ? code + pc->dst : pc + 1;
+		DISPATCH();
+	}
+
+	BRANCH(BREQ, ==)
+	BRANCH(BRNE, !=)
+	BRANCH(BRGT, >)
+	BRANCH(BRLT, <)
+	BRANCH(BRGE, >=)
+	BRANCH(BRLE, <=)
+
+	// the frame of callee starts at args, temps are sized by translator
+	HANDLER(CALL): {
+		const RegFunc& callee = funcs[pc->b];
+		var* base = bp + pc->a;
+		if (static_cast<uint64_t>(limit - base) < callee.size || fp == frameLimit) {
+			FAIL("Call: stack overflow.");
+		}
+		*fp++ = { static_cast<uint64_t>(pc - code), static_cast<uint64_t>(bp - stack), pc->b };
+		bp = base;
+		for (uint32_t i = callee.argc; i < callee.argc + callee.varc; i++) {
+			bp[i] = 0LL;
+		}
+		pc = code + callee.entry;
+		DISPATCH();
+	}
+
+	// args move down to bp and callee runs in the frame
+	HANDLER(TAILCALL): {
+		const RegFunc& callee = funcs[pc->b];
+		if (static_cast<uint64_t>(limit - bp) < callee.size) {
+			FAIL("TailCall: stack overflow.");
+		}
+		const var* args = bp + pc->a;
+		for (uint32_t i = 0; i < callee.argc; i++) {
+			bp[i] = args[i];
+		}
+		for (uint32_t i = callee.argc; i < callee.argc + callee.varc; i++) {
+			bp[i] = 0LL;
+		}
+		if (fp != base) {
+			(fp - 1)->func = pc->b;
+		}
+		pc = code + callee.entry;
+		DISPATCH();
+	}
+
+	HANDLER(RET):
+	HANDLER(RETI):
+	HANDLER(RETV): {
+		value = pc->op == RegOp::RET ? R(pc->a) : pc->op == RegOp::RETI ? pc->imm : 0LL;
+		if (fp == base) {
+			leave = Leave::RETURN;
+			goto done;
+		}
+		bp[0] = value;
+		--fp;
+		bp = stack + fp->bp;
+		pc = code + fp->ip + 1;
+		DISPATCH();
+	}
+
+	HANDLER(EXIT):
+	HANDLER(EXITI):
+	HANDLER(EXITV): {
+		cpu.exitCode = pc->op == RegOp::EXIT ? R(pc->a) : pc->op == RegOp::EXITI ? pc->imm : 0LL;
+		std::cout << "[EXIT]: " << cpu.exitCode << std::endl;
+		cpu.exit = true;
+		value = cpu.exitCode;
+		leave = Leave::EXIT;
+		goto done;
+	}
+
+	HANDLER(HALT): {
+		leave = Leave::HALT;
+		goto done;
+	}
+
+	HANDLER(NIL): {
+		FAIL("Instruction is error.");
+	}
+
+#if !HYS_COMPUTED_GOTO
+	default:
+		FAIL("Instruction is error.");
+	}
+#endif
+
+done:
+	cpu.ip = pc - code;
+	cpu.bp = bp - stack;
+	cpu.fp = fp - frames;
+	if constexpr (kCount) {
+		tracer->Message("[stats]: register dispatches " + std::to_string(count));
+		tracer->Flush();
+	}
+	return true;
+
+fail:
+	cpu.ip = pc - code;
+	std::cerr << "[err]: Exec register " << cpu.ip << " " << regOpStrs[static_cast<size_t>(pc->op)] <<
+		" failed: " << err << std::endl;
+	return false;
+
+#undef R
+#undef FAIL
+#undef DISPATCH
+#undef HANDLER
+#undef NEXT
+#undef BINARY
+#undef BRANCH
+}
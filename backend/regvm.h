@@ -0,0 +1,199 @@
+/**
+ * @file regvm.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef REGVM_H
+#define REGVM_H
+
+#include "instruction.h"
+#include "tracer.h"
+
+// Three-address form of a verified program.
+// A frame is the same as the one of stack machine: [args][locals][temps],
+// register r is bp[r], and the temp of stack depth d is the register argc + varc + d.
+// So a call passes args in place and gets the return value at the base of args.
+enum class RegOp : uint8_t {
+    NIL = 0x0,
+    // dst = a op b
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    AND,
+    OR,
+    BITAND,
+    BITOR,
+    BITXOR,
+    CMPEQ,
+    CMPNE,
+    CMPGT,
+    CMPLT,
+    CMPGE,
+    CMPLE,
+    // dst = a op imm
+    ADDI,
+    SUBI,
+    MULI,
+    DIVI,   // imm is not 0
+    MODI,   // imm is not 0
+    ANDI,
+    ORI,
+    BITANDI,
+    BITORI,
+    BITXORI,
+    CMPEQI,
+    CMPNEI,
+    CMPGTI,
+    CMPLTI,
+    CMPGEI,
+    CMPLEI,
+    NEG,    // dst = -a
+    NOT,    // dst = !a
+    // dst = a op 2^imm by shifts, as shli, shri and maski
+    SHLI,
+    SHRI,
+    MASKI,
+    MOV,    // dst = a
+    MOVI,   // dst = imm
+    JMP,    // dst = target ip
+    JZ,     // jump to dst if a is 0
+    // jump to dst if a cmp b is false, as the fused cmpxx; jz
+    BREQ,
+    BRNE,
+    BRGT,
+    BRLT,
+    BRGE,
+    BRLE,
+    // jump to dst if a cmp imm is false
+    BREQI,
+    BRNEI,
+    BRGTI,
+    BRLTI,
+    BRGEI,
+    BRLEI,
+    CALL,   // args start at register a, b = index of funcs
+    TAILCALL, // as call, in place of the current frame
+    RET,    // return a
+    RETI,   // return imm
+    RETV,
+    EXIT,   // exit with a
+    EXITI,  // exit with imm
+    EXITV,
+    HALT,
+    MAX
+};
+
+struct RegCode {
+    RegOp op;
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+    var imm;
+};
+
+struct RegFunc {
+    std::string name;
+    uint64_t entry;
+    uint32_t argc;
+    uint32_t varc;
+    // registers of a frame, slots and temps
+    uint32_t size;
+};
+
+struct RegProgram {
+    inline void Clear() {
+        code.clear();
+        funcs.clear();
+        labels.clear();
+        indexes.clear();
+    }
+
+    void Print() const;
+
+    std::vector<RegCode> code;
+    std::vector<RegFunc> funcs;
+    std::map<uint64_t, std::string> labels;
+    // ip of bytecode to ip of register code, valid where the stack is empty, e.g. loop heads
+    std::vector<uint64_t> indexes;
+};
+
+// Translates the stack code with a symbolic stack: pushes of locals and immediates emit nothing,
+// they become operands of the instruction consuming them, and the result is retargeted
+// to the local it is popped to. So push a; push 1; sub; pop a is one subi a, a, 1.
+// Values are put in their temps only at block boundaries and calls.
+class RegVm {
+public:
+    // program must be verified, whose stack depth of every instruction is known
+    bool Translate(const Program& program);
+
+    // runs on the stack and frames of cpu, tracer may be nullptr
+    bool Run(Cpu& cpu, Tracer* tracer, var& ret);
+
+    // how the register code is left
+    enum class Leave {
+        RETURN, // the entered frame returns value
+        EXIT,   // exit with value
+        HALT
+    };
+
+    // Continues a frame of the stack code at ip of register code, e.g. a callee just set up,
+    // or a loop head where the stack of frame is empty. Frames above fp are of register code.
+    bool Enter(Cpu& cpu, uint64_t ip, uint64_t bp, uint64_t fp, var& value, Leave& leave);
+
+    inline uint64_t GetEntry(uint32_t funcIdx) const {
+        return program_.funcs[funcIdx].entry;
+    }
+
+    // ip of register code for a block head of bytecode
+    inline uint64_t GetIndex(uint64_t ip) const {
+        return program_.indexes[ip];
+    }
+
+    inline const RegProgram& GetProgram() const {
+        return program_;
+    }
+
+private:
+    // operand of symbolic stack, a register or an immediate
+    struct Operand {
+        bool imm;
+        uint32_t reg;
+        var value;
+    };
+
+    bool TranslateFunc(const Program& program, uint32_t funcIdx);
+    bool Depths(const Program& program, const FuncInfo& func);
+    void Emit(RegOp op, uint32_t dst, uint32_t a, uint32_t b, var imm);
+    // put operand at depth into its temp
+    void Materialize(size_t depth);
+    // put all operands into their temps, at block boundaries
+    void Flush();
+    // operands which read the local are materialized before it is written
+    bool Alias(uint32_t slot);
+    void Binary(OpCode op, Operand left, Operand right);
+    void Assign(uint32_t slot, const Operand& value);
+    uint32_t Temp(size_t depth) const;
+
+    template <bool kCount>
+    bool Exec(Cpu& cpu, Tracer* tracer, uint64_t ip, uint64_t bp0, uint64_t fp0, var& value, Leave& leave);
+
+    RegProgram program_;
+
+    // states of the function being translated
+    std::vector<int64_t> depths_;
+    std::vector<bool> targets_;
+    std::vector<Operand> stack_;
+    uint32_t slots_{ 0 };
+    // index of the last instruction which defined the stack top, to retarget
+    uint64_t lastDef_{ UINT64_MAX };
+};
+
+#endif
@@ -0,0 +1,57 @@
+FUNC @twice:
+	twice.arg n
+	twice.var unused
+	push n
+	push 5
+	mul
+	pop unused
+	push n
+	push n
+	add
+	ret ~
+	push 0
+	pop n
+ENDFUNC@twice
+
+FUNC @main:
+	main.var a, b, c
+	push 4
+	pop a
+	push a
+	push 9
+	mul
+	pop b
+	push a
+	call twice
+	pop b
+	push a
+	push b
+	add
+	pop c
+_begIf_1:
+	push a
+	push 100
+	cmpgt
+	jz _elIf_1
+	push 0
+	pop c
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+_begWhile_1:
+	push a
+	push 0
+	cmplt
+	jz _endWhile_1
+	push c
+	push 1
+	sub
+	pop c
+	jmp _begWhile_1
+_endWhile_1:
+	push c
+	ret ~
+	push 0
+	ret ~
+ENDFUNC@main
+
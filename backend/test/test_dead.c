@@ -0,0 +1,22 @@
+int twice(int n) {
+    int unused;
+    unused = n * 5;
+    return n + n;
+    n = 0;
+}
+
+int main() {
+    int a, b, c;
+    a = 4;
+    b = a * 9;
+    b = twice(a);
+    c = a + b;
+    if (a > 100) {
+        c = 0;
+    }
+    while (a < 0) {
+        c = c - 1;
+    }
+    return c;
+    return 0;
+}
@@ -0,0 +1,18 @@
+FUNC @main:
+	main.var d, x, y
+	push 0
+	pop d
+	push 7
+	pop x
+	push x
+	push 3
+	mul
+	pop y
+	push 5
+	push d
+	div
+	pop y
+	push x
+	ret ~
+ENDFUNC@main
+
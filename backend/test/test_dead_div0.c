@@ -0,0 +1,8 @@
+int main() {
+    int d, x, y;
+    d = 0;
+    x = 7;
+    y = x * 3;
+    y = 5 / d;
+    return x;
+}
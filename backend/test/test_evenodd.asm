@@ -0,0 +1,49 @@
+FUNC @main:
+	push 1000001
+	call even
+	push 10
+	mul
+	push 1000001
+	call odd
+	add
+	ret ~
+ENDFUNC@main
+
+FUNC @even:
+	even.arg n
+_begIf_1:
+	push n
+	push 0
+	cmpeq
+	jz _elIf_1
+	push 1
+	ret ~
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push n
+	push 1
+	sub
+	call odd
+	ret ~
+ENDFUNC@even
+
+FUNC @odd:
+	odd.arg n
+_begIf_2:
+	push n
+	push 0
+	cmpeq
+	jz _elIf_2
+	push 0
+	ret ~
+	jmp _endIf_2
+_elIf_2:
+_endIf_2:
+	push n
+	push 1
+	sub
+	call even
+	ret ~
+ENDFUNC@odd
+
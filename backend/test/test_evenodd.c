@@ -0,0 +1,17 @@
+int main() {
+    return even(1000001) * 10 + odd(1000001);
+}
+
+int even(int n) {
+    if (n == 0) {
+        return 1;
+    }
+    return odd(n - 1);
+}
+
+int odd(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    return even(n - 1);
+}
@@ -0,0 +1,33 @@
+FUNC @main:
+	main.var n
+	push 20
+	pop n
+	push n
+	call fib
+	ret ~
+ENDFUNC@main
+
+FUNC @fib:
+	fib.arg n
+_begIf_1:
+	push n
+	push 2
+	cmplt
+	jz _elIf_1
+	push n
+	ret ~
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push n
+	push 1
+	sub
+	call fib
+	push n
+	push 2
+	sub
+	call fib
+	add
+	ret ~
+ENDFUNC@fib
+
@@ -0,0 +1,12 @@
+int main() {
+    int n;
+    n = 20;
+    return fib(n);
+}
+
+int fib(int n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+FUNC @main:
+	main.var a, b, c, d, m, w, e, n
+	push 6
+	pop a
+	push a
+	push 7
+	mul
+	pop b
+	push b
+	push 2
+	sub
+	push 4
+	div
+	pop c
+_begIf_1:
+	push c
+	push 5
+	cmpgt
+	jz _elIf_1
+	push a
+	push c
+	add
+	pop d
+	jmp _endIf_1
+_elIf_1:
+	push a
+	push c
+	sub
+	pop d
+_endIf_1:
+_begWhile_1:
+	push a
+	push 9
+	cmplt
+	jz _endWhile_1
+	push a
+	push 1
+	add
+	pop a
+	jmp _begWhile_1
+_endWhile_1:
+	push 9223372036854775798
+	push a
+	add
+	pop m
+	push m
+	push 1
+	add
+	pop w
+	push w
+	push 1
+	sub
+	pop e
+	push w
+	neg
+	pop n
+	push a
+	push 1000
+	mul
+	push d
+	push 10
+	mul
+	add
+	push b
+	push 5
+	mod
+	add
+	push c
+	neg
+	push 3
+	div
+	sub
+	push e
+	push m
+	cmpeq
+	add
+	push n
+	push w
+	cmpeq
+	add
+	push m
+	push 2
+	mul
+	push 2
+	neg
+	cmpeq
+	add
+	push m
+	push m
+	add
+	push 2
+	neg
+	cmpeq
+	add
+	push w
+	push m
+	sub
+	add
+	ret ~
+ENDFUNC@main
+
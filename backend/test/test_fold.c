@@ -0,0 +1,20 @@
+int main() {
+    int a, b, c, d, m, w, e, n;
+    a = 6;
+    b = a * 7;
+    c = (b - 2) / 4;
+    if (c > 5) {
+        d = a + c;
+    } else {
+        d = a - c;
+    }
+    while (a < 9) {
+        a = a + 1;
+    }
+    m = 9223372036854775798 + a;
+    w = m + 1;
+    e = w - 1;
+    n = -w;
+    return a * 1000 + d * 10 + b % 5 - -c / 3 +
+        (e == m) + (n == w) + (m * 2 == -2) + (m + m == -2) + (w - m);
+}
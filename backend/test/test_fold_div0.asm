@@ -0,0 +1,24 @@
+FUNC @main:
+	main.var a, z
+	push 7
+	pop a
+	push a
+	push 7
+	sub
+	pop z
+_begIf_1:
+	push a
+	push 100
+	cmpgt
+	jz _elIf_1
+	push 0
+	ret ~
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push a
+	push z
+	div
+	ret ~
+ENDFUNC@main
+
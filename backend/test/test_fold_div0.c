@@ -0,0 +1,9 @@
+int main() {
+    int a, z;
+    a = 7;
+    z = a - 7;
+    if (a > 100) {
+        return 0;
+    }
+    return a / z;
+}
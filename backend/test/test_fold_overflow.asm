@@ -0,0 +1,17 @@
+FUNC @main:
+	main.var m, d
+	push 9223372036854775807
+	neg
+	push 1
+	sub
+	pop m
+	push 0
+	push 1
+	sub
+	pop d
+	push m
+	push d
+	div
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,6 @@
+int main() {
+    int m, d;
+    m = -9223372036854775807 - 1;
+    d = 0 - 1;
+    return m / d;
+}
@@ -0,0 +1,103 @@
+FUNC @sum:
+	sum.arg a, b, d, e
+	sum.var i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 20
+	cmplt
+	jz _endWhile_1
+	push s
+	push a
+	push b
+	mul
+	add
+	push i
+	add
+	pop s
+_begIf_1:
+	push d
+	push 0
+	cmpne
+	jz _elIf_1
+	push s
+	push 100
+	push d
+	div
+	add
+	pop s
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push 0
+	pop i
+_begWhile_2:
+	push i
+	push d
+	cmplt
+	jz _endWhile_2
+	push s
+	push 100
+	push d
+	div
+	add
+	push 100
+	push d
+	mod
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_2
+_endWhile_2:
+	push 0
+	pop i
+_begWhile_3:
+	push i
+	push 5
+	cmplt
+	jz _endWhile_3
+_begIf_2:
+	push e
+	push 0
+	cmpne
+	jz _elIf_2
+	push s
+	push 100
+	push e
+	div
+	add
+	pop s
+	jmp _endIf_2
+_elIf_2:
+_endIf_2:
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_3
+_endWhile_3:
+	push s
+	ret ~
+ENDFUNC@sum
+
+FUNC @main:
+	push 6
+	push 7
+	push 0
+	push 3
+	call sum
+	ret ~
+ENDFUNC@main
+
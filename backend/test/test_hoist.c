@@ -0,0 +1,29 @@
+int sum(int a, int b, int d, int e) {
+    int i, s;
+    i = 0;
+    s = 0;
+    while (i < 20) {
+        s = s + a * b + i;
+        if (d != 0) {
+            s = s + 100 / d;
+        }
+        i = i + 1;
+    }
+    i = 0;
+    while (i < d) {
+        s = s + 100 / d + 100 % d;
+        i = i + 1;
+    }
+    i = 0;
+    while (i < 5) {
+        if (e != 0) {
+            s = s + 100 / e;
+        }
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return sum(6, 7, 0, 3);
+}
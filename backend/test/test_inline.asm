@@ -0,0 +1,94 @@
+FUNC @sq:
+	sq.arg x
+	push x
+	push x
+	mul
+	ret ~
+ENDFUNC@sq
+
+FUNC @fact:
+	fact.arg n
+_begIf_1:
+	push n
+	push 2
+	cmplt
+	jz _elIf_1
+	push 1
+	ret ~
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push n
+	push n
+	push 1
+	sub
+	call fact
+	mul
+	ret ~
+ENDFUNC@fact
+
+FUNC @ping:
+	ping.arg n
+_begIf_2:
+	push n
+	push 0
+	cmpeq
+	jz _elIf_2
+	push 0
+	ret ~
+	jmp _endIf_2
+_elIf_2:
+_endIf_2:
+	push n
+	push 1
+	sub
+	call pong
+	push 1
+	add
+	ret ~
+ENDFUNC@ping
+
+FUNC @pong:
+	pong.arg n
+_begIf_3:
+	push n
+	push 0
+	cmpeq
+	jz _elIf_3
+	push 0
+	ret ~
+	jmp _endIf_3
+_elIf_3:
+_endIf_3:
+	push n
+	push 1
+	sub
+	call ping
+	push 2
+	add
+	ret ~
+ENDFUNC@pong
+
+FUNC @both:
+	both.arg n
+	push n
+	call fact
+	push n
+	call sq
+	add
+	ret ~
+ENDFUNC@both
+
+FUNC @main:
+	push 5
+	call both
+	push 7
+	call ping
+	add
+	push 3
+	call fact
+	call sq
+	add
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,32 @@
+int sq(int x) {
+    return x * x;
+}
+
+int fact(int n) {
+    if (n < 2) {
+        return 1;
+    }
+    return n * fact(n - 1);
+}
+
+int ping(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    return pong(n - 1) + 1;
+}
+
+int pong(int n) {
+    if (n == 0) {
+        return 0;
+    }
+    return ping(n - 1) + 2;
+}
+
+int both(int n) {
+    return fact(n) + sq(n);
+}
+
+int main() {
+    return both(5) + ping(7) + sq(fact(3));
+}
@@ -0,0 +1,39 @@
+FUNC @main:
+	main.var i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 1000
+	cmplt
+	jz _endWhile_1
+_begIf_1:
+	push i
+	push 100
+	mod
+	push 7
+	cmpeq
+	jz _elIf_1
+	push s
+	push 3
+	add
+	pop s
+	jmp _endIf_1
+_elIf_1:
+	push s
+	push 1
+	add
+	pop s
+_endIf_1:
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,14 @@
+int main() {
+    int i, s;
+    i = 0;
+    s = 0;
+    while (i < 1000) {
+        if (i % 100 == 7) {
+            s = s + 3;
+        } else {
+            s = s + 1;
+        }
+        i = i + 1;
+    }
+    return s;
+}
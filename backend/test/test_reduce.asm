@@ -0,0 +1,83 @@
+FUNC @main:
+	main.var x, s
+	push 21
+	neg
+	pop x
+	push 0
+	pop s
+_begWhile_1:
+	push x
+	push 22
+	cmplt
+	jz _endWhile_1
+	push s
+	push 3
+	mul
+	push x
+	push 8
+	mul
+	add
+	push x
+	push 8
+	div
+	add
+	push x
+	push 8
+	mod
+	add
+	push x
+	push 4
+	neg
+	div
+	add
+	push x
+	push 4
+	neg
+	mod
+	add
+	pop s
+	push s
+	push x
+	push 1
+	mul
+	add
+	push x
+	push 1
+	div
+	add
+	push x
+	push 1
+	mod
+	add
+	push x
+	push 0
+	mul
+	add
+	push x
+	add
+	push 0
+	sub
+	push x
+	push 1
+	neg
+	mul
+	add
+	push x
+	push 2
+	mul
+	add
+	pop s
+	push s
+	push 1000003
+	mod
+	pop s
+	push x
+	push 1
+	add
+	pop x
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,12 @@
+int main() {
+    int x, s;
+    x = -21;
+    s = 0;
+    while (x < 22) {
+        s = s * 3 + x * 8 + x / 8 + x % 8 + x / -4 + x % -4;
+        s = s + x * 1 + x / 1 + x % 1 + x * 0 + x - 0 + x * -1 + x * 2;
+        s = s % 1000003;
+        x = x + 1;
+    }
+    return s;
+}
@@ -0,0 +1,122 @@
+FUNC @bump:
+	bump.arg a
+	push a
+	push 1
+	add
+	ret ~
+ENDFUNC@bump
+
+FUNC @main:
+	main.var a, b, c, d, i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 10
+	cmplt
+	jz _endWhile_1
+	push i
+	push 3
+	mul
+	pop a
+	push i
+	push 5
+	add
+	pop b
+	push a
+	push b
+	add
+	push a
+	push b
+	sub
+	mul
+	pop c
+	push a
+	push b
+	sub
+	push b
+	push a
+	add
+	mul
+	push c
+	add
+	pop d
+	push s
+	push c
+	add
+	push d
+	add
+	pop s
+	push a
+	push 1
+	add
+	pop a
+	push a
+	push b
+	add
+	push a
+	push b
+	sub
+	mul
+	pop c
+	push s
+	push c
+	add
+	pop s
+_begIf_1:
+	push i
+	push 2
+	mod
+	push 0
+	cmpeq
+	jz _elIf_1
+	push b
+	call bump
+	pop b
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push a
+	push b
+	add
+	push a
+	push b
+	sub
+	mul
+	pop d
+	push a
+	push b
+	mul
+	pop c
+	push a
+	push b
+	add
+	push a
+	push b
+	sub
+	mul
+	push c
+	add
+	pop b
+	push s
+	push d
+	add
+	push b
+	add
+	push a
+	push b
+	mul
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,28 @@
+int bump(int a) {
+    return a + 1;
+}
+
+int main() {
+    int a, b, c, d, i, s;
+    i = 0;
+    s = 0;
+    while (i < 10) {
+        a = i * 3;
+        b = i + 5;
+        c = (a + b) * (a - b);
+        d = (a - b) * (b + a) + c;
+        s = s + c + d;
+        a = a + 1;
+        c = (a + b) * (a - b);
+        s = s + c;
+        if (i % 2 == 0) {
+            b = bump(b);
+        }
+        d = (a + b) * (a - b);
+        c = a * b;
+        b = (a + b) * (a - b) + c;
+        s = s + d + b + a * b;
+        i = i + 1;
+    }
+    return s;
+}
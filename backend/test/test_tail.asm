@@ -0,0 +1,73 @@
+FUNC @main:
+	push 1000000
+	push 0
+	call sum
+	push 1000
+	mod
+	push 5
+	push 7
+	call count
+	add
+	ret ~
+ENDFUNC@main
+
+FUNC @sum:
+	sum.arg n, acc
+_begIf_1:
+	push n
+	push 0
+	cmpeq
+	jz _elIf_1
+	push acc
+	ret ~
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push n
+	push 1
+	sub
+	push acc
+	push n
+	add
+	call sum
+	ret ~
+ENDFUNC@sum
+
+FUNC @count:
+	count.arg n, acc
+	count.var i
+	push 0
+	pop i
+_begWhile_1:
+	push i
+	push n
+	cmplt
+	jz _endWhile_1
+	push acc
+	push i
+	add
+	pop acc
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+_begIf_2:
+	push acc
+	push 1000
+	cmpgt
+	jz _elIf_2
+	push acc
+	ret ~
+	jmp _endIf_2
+_elIf_2:
+_endIf_2:
+	push n
+	push acc
+	push 2
+	mul
+	call count
+	ret ~
+ENDFUNC@count
+
@@ -0,0 +1,23 @@
+int main() {
+    return sum(1000000, 0) % 1000 + count(5, 7);
+}
+
+int sum(int n, int acc) {
+    if (n == 0) {
+        return acc;
+    }
+    return sum(n - 1, acc + n);
+}
+
+int count(int n, int acc) {
+    int i;
+    i = 0;
+    while (i < n) {
+        acc = acc + i;
+        i = i + 1;
+    }
+    if (acc > 1000) {
+        return acc;
+    }
+    return count(n, acc * 2);
+}
@@ -0,0 +1,102 @@
+FUNC @main:
+	main.var i, j, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 30
+	cmplt
+	jz _endWhile_1
+	push i
+	push 1
+	add
+	pop i
+_begIf_1:
+	push i
+	push 3
+	mod
+	push 0
+	cmpeq
+	jz _elIf_1
+	jmp _begWhile_1
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push 0
+	pop j
+_begWhile_2:
+	push 1
+	jz _endWhile_2
+	push j
+	push 1
+	add
+	pop j
+_begIf_2:
+	push j
+	push i
+	cmpgt
+	jz _elIf_2
+	jmp _endWhile_2
+	jmp _endIf_2
+_elIf_2:
+_endIf_2:
+_begIf_3:
+	push j
+	push 2
+	mod
+	push 0
+	cmpeq
+	jz _elIf_3
+_begIf_4:
+	push j
+	push 4
+	mod
+	push 0
+	cmpeq
+	jz _elIf_4
+	push s
+	push 3
+	add
+	pop s
+	jmp _endIf_4
+_elIf_4:
+	push s
+	push 2
+	add
+	pop s
+_endIf_4:
+	jmp _endIf_3
+_elIf_3:
+_begIf_5:
+	push i
+	push 20
+	cmpgt
+	jz _elIf_5
+	jmp _endWhile_2
+	jmp _endIf_5
+_elIf_5:
+	push s
+	push 1
+	add
+	pop s
+_endIf_5:
+_endIf_3:
+	jmp _begWhile_2
+_endWhile_2:
+_begIf_6:
+	push s
+	push 1000
+	cmpgt
+	jz _elIf_6
+	jmp _endWhile_1
+	jmp _endIf_6
+_elIf_6:
+_endIf_6:
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@main
+
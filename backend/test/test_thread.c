@@ -0,0 +1,35 @@
+int main() {
+    int i, j, s;
+    i = 0;
+    s = 0;
+    while (i < 30) {
+        i = i + 1;
+        if (i % 3 == 0) {
+            continue;
+        }
+        j = 0;
+        while (1) {
+            j = j + 1;
+            if (j > i) {
+                break;
+            }
+            if (j % 2 == 0) {
+                if (j % 4 == 0) {
+                    s = s + 3;
+                } else {
+                    s = s + 2;
+                }
+            } else {
+                if (i > 20) {
+                    break;
+                } else {
+                    s = s + 1;
+                }
+            }
+        }
+        if (s > 1000) {
+            break;
+        }
+    }
+    return s;
+}
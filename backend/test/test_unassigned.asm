@@ -0,0 +1,33 @@
+FUNC @pick:
+	pick.arg x
+	pick.var b
+_begIf_1:
+	push x
+	push 0
+	cmpgt
+	jz _elIf_1
+	push x
+	push 2
+	mul
+	pop b
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push b
+	push 1
+	add
+	ret ~
+ENDFUNC@pick
+
+FUNC @main:
+	main.var a
+	push 3
+	call pick
+	pop a
+	push a
+	push 0
+	call pick
+	add
+	ret ~
+ENDFUNC@main
+
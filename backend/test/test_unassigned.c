@@ -0,0 +1,13 @@
+int pick(int x) {
+    int b;
+    if (x > 0) {
+        b = x * 2;
+    }
+    return b + 1;
+}
+
+int main() {
+    int a;
+    a = pick(3);
+    return a + pick(0);
+}
@@ -0,0 +1,133 @@
+FUNC @upto:
+	upto.arg n
+	upto.var i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push n
+	cmplt
+	jz _endWhile_1
+	push s
+	push i
+	push i
+	mul
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@upto
+
+FUNC @steps:
+	steps.arg n
+	steps.var i, s
+	push 1
+	pop i
+	push 0
+	pop s
+_begWhile_2:
+	push i
+	push n
+	cmple
+	jz _endWhile_2
+	push s
+	push i
+	add
+	pop s
+	push i
+	push 3
+	add
+	pop i
+	jmp _begWhile_2
+_endWhile_2:
+	push s
+	ret ~
+ENDFUNC@steps
+
+FUNC @down:
+	down.arg n
+	down.var i, s
+	push n
+	pop i
+	push 0
+	pop s
+_begWhile_3:
+	push i
+	push 5
+	neg
+	cmpgt
+	jz _endWhile_3
+	push s
+	push 2
+	mul
+	push i
+	add
+	pop s
+	push i
+	push 2
+	sub
+	pop i
+	jmp _begWhile_3
+_endWhile_3:
+	push s
+	ret ~
+ENDFUNC@down
+
+FUNC @main:
+	main.var s
+	push 0
+	call upto
+	push 3
+	neg
+	call upto
+	add
+	push 1
+	call upto
+	add
+	push 7
+	call upto
+	add
+	push 100
+	call upto
+	add
+	pop s
+	push s
+	push 0
+	call steps
+	add
+	push 1
+	call steps
+	add
+	push 20
+	call steps
+	add
+	push 22
+	call steps
+	add
+	pop s
+	push s
+	push 7
+	neg
+	call down
+	add
+	push 5
+	neg
+	call down
+	add
+	push 6
+	call down
+	add
+	push 30
+	call down
+	add
+	ret ~
+ENDFUNC@main
+
@@ -0,0 +1,39 @@
+int upto(int n) {
+    int i, s;
+    i = 0;
+    s = 0;
+    while (i < n) {
+        s = s + i * i;
+        i = i + 1;
+    }
+    return s;
+}
+
+int steps(int n) {
+    int i, s;
+    i = 1;
+    s = 0;
+    while (i <= n) {
+        s = s + i;
+        i = i + 3;
+    }
+    return s;
+}
+
+int down(int n) {
+    int i, s;
+    i = n;
+    s = 0;
+    while (i > -5) {
+        s = s * 2 + i;
+        i = i - 2;
+    }
+    return s;
+}
+
+int main() {
+    int s;
+    s = upto(0) + upto(-3) + upto(1) + upto(7) + upto(100);
+    s = s + steps(0) + steps(1) + steps(20) + steps(22);
+    return s + down(-7) + down(-5) + down(6) + down(30);
+}
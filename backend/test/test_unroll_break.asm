@@ -0,0 +1,50 @@
+FUNC @stop:
+	stop.arg n
+	stop.var i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 9223372036854775807
+	cmplt
+	jz _endWhile_1
+_begIf_1:
+	push i
+	push n
+	cmpeq
+	jz _elIf_1
+	jmp _endWhile_1
+	jmp _endIf_1
+_elIf_1:
+_endIf_1:
+	push s
+	push i
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@stop
+
+FUNC @main:
+	push 0
+	call stop
+	push 1
+	call stop
+	add
+	push 13
+	call stop
+	add
+	push 50
+	call stop
+	add
+	ret ~
+ENDFUNC@main
+
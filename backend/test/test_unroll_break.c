@@ -0,0 +1,17 @@
+int stop(int n) {
+    int i, s;
+    i = 0;
+    s = 0;
+    while (i < 9223372036854775807) {
+        if (i == n) {
+            break;
+        }
+        s = s + i;
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return stop(0) + stop(1) + stop(13) + stop(50);
+}
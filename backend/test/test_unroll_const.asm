@@ -0,0 +1,57 @@
+FUNC @sum:
+	sum.var i, s
+	push 0
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 6
+	cmplt
+	jz _endWhile_1
+	push s
+	push i
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@sum
+
+FUNC @none:
+	none.var i, s
+	push 5
+	pop i
+	push 7
+	pop s
+_begWhile_2:
+	push i
+	push 5
+	cmplt
+	jz _endWhile_2
+	push s
+	push i
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_2
+_endWhile_2:
+	push s
+	ret ~
+ENDFUNC@none
+
+FUNC @main:
+	call sum
+	call none
+	add
+	ret ~
+ENDFUNC@main
+
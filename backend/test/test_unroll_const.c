@@ -0,0 +1,25 @@
+int sum() {
+    int i, s;
+    i = 0;
+    s = 0;
+    while (i < 6) {
+        s = s + i;
+        i = i + 1;
+    }
+    return s;
+}
+
+int none() {
+    int i, s;
+    i = 5;
+    s = 7;
+    while (i < 5) {
+        s = s + i;
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return sum() + none();
+}
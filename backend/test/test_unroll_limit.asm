@@ -0,0 +1,103 @@
+FUNC @most:
+	most.var i, s
+	push 9223372036854775807
+	push 100
+	sub
+	pop i
+	push 0
+	pop s
+_begWhile_1:
+	push i
+	push 9223372036854775807
+	cmplt
+	jz _endWhile_1
+	push s
+	push 1
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_1
+_endWhile_1:
+	push s
+	ret ~
+ENDFUNC@most
+
+FUNC @least:
+	least.var i, s
+	push 9223372036854775807
+	neg
+	push 99
+	add
+	pop i
+	push 0
+	pop s
+_begWhile_2:
+	push i
+	push 9223372036854775807
+	neg
+	push 1
+	sub
+	cmpgt
+	jz _endWhile_2
+	push s
+	push 2
+	add
+	pop s
+	push i
+	push 1
+	sub
+	pop i
+	jmp _begWhile_2
+_endWhile_2:
+	push s
+	ret ~
+ENDFUNC@least
+
+FUNC @wraps:
+	wraps.arg n
+	wraps.var i, s
+	push 9223372036854775807
+	neg
+	push 1
+	sub
+	pop i
+	push 0
+	pop s
+_begWhile_3:
+	push i
+	push 9223372036854775807
+	neg
+	push n
+	add
+	cmplt
+	jz _endWhile_3
+	push s
+	push 3
+	add
+	pop s
+	push i
+	push 1
+	add
+	pop i
+	jmp _begWhile_3
+_endWhile_3:
+	push s
+	ret ~
+ENDFUNC@wraps
+
+FUNC @main:
+	call most
+	call least
+	add
+	push 1
+	call wraps
+	add
+	push 9
+	call wraps
+	add
+	ret ~
+ENDFUNC@main
+
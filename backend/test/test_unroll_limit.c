@@ -0,0 +1,36 @@
+int most() {
+    int i, s;
+    i = 9223372036854775807 - 100;
+    s = 0;
+    while (i < 9223372036854775807) {
+        s = s + 1;
+        i = i + 1;
+    }
+    return s;
+}
+
+int least() {
+    int i, s;
+    i = -9223372036854775807 + 99;
+    s = 0;
+    while (i > -9223372036854775807 - 1) {
+        s = s + 2;
+        i = i - 1;
+    }
+    return s;
+}
+
+int wraps(int n) {
+    int i, s;
+    i = -9223372036854775807 - 1;
+    s = 0;
+    while (i < -9223372036854775807 + n) {
+        s = s + 3;
+        i = i + 1;
+    }
+    return s;
+}
+
+int main() {
+    return most() + least() + wraps(1) + wraps(9);
+}
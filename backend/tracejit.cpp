@@ -0,0 +1,603 @@
+/**
+ * @file tracejit.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#include "tracejit.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// The trace is int64_t trace(var* bp), rdi is bp. rax, rcx and rdx are scratch,
+// the shallow temps of stack depths and promoted locals have registers of their own.
+constexpr int BP = 7;
+constexpr int tempRegs[] = { 8, 9, 10, 11 };
+// rbx, rsi, r12 ~ r15
+constexpr int localRegs[] = { 3, 6, 12, 13, 14, 15 };
+
+inline int32_t Slot(uint32_t slot) {
+	return static_cast<int32_t>(slot) * static_cast<int32_t>(sizeof(var));
+}
+
+inline bool IsCalleeSaved(int reg) {
+	return reg == 3 || reg >= 12;
+}
+
+inline bool IsBinary(OpCode op) {
+	return op >= OpCode::ADD && op <= OpCode::CMPLE && op != OpCode::NEG && op != OpCode::NOT;
+}
+
+inline bool IsCompare(OpCode op) {
+	return op >= OpCode::CMPEQ && op <= OpCode::CMPLE;
+}
+
+// of addi ~ modi
+const OpCode immOps[] = { OpCode::ADD, OpCode::SUB, OpCode::MUL, OpCode::DIV, OpCode::MOD };
+
+} // namespace
+
+TraceJit::~TraceJit() {
+	for (auto& trace : traces_) {
+		Uninstall(trace.code, trace.size);
+	}
+}
+
+void TraceJit::Reset(const Program& program) {
+	for (auto& trace : traces_) {
+		Uninstall(trace.code, trace.size);
+	}
+	states_.assign(program.code.size(), State::UNTRIED);
+	attempts_.assign(program.code.size(), 0);
+	traces_.assign(program.code.size(), { nullptr, 0, 0 });
+}
+
+bool TraceJit::Record(const Program& program, uint64_t head, uint32_t funcIdx, uint64_t depth, const var* bp) {
+	const auto& func = program.funcs[funcIdx];
+	states_[head] = State::FAILED;
+#if !HYS_JIT
+	(void)depth;
+	(void)bp;
+	return false;
+#else
+	if (depth != func.argc + func.varc) {
+		return false;
+	}
+	if (!Simulate(program, head, func, bp)) {
+		if (++attempts_[head] < MAX_TRACE_ATTEMPTS) {
+			states_[head] = State::UNTRIED;
+		}
+		return false;
+	}
+	auto& trace = traces_[head];
+	if (!Compile(program, func, trace)) {
+		return false;
+	}
+	states_[head] = State::READY;
+	return true;
+#endif
+}
+
+// runs an iteration on a copy of locals, it fails at what a trace does not support
+bool TraceJit::Simulate(const Program& program, uint64_t head, const FuncInfo& func, const var* bp) {
+	const auto& code = program.code;
+	std::vector<var> locals(bp, bp + func.argc + func.varc);
+	std::vector<var> stack;
+	auto pop = [&stack]() {
+		var value = stack.back();
+		stack.pop_back();
+		return value;
+	};
+
+	steps_.clear();
+	maxDepth_ = 0;
+	uint64_t ip = head;
+	while (steps_.size() < MAX_TRACE_LENGTH) {
+		const auto& bc = code[ip];
+		uint64_t next = ip + 1;
+		bool branch = false;
+		bool taken = false;
+		switch (bc.op) {
+		case OpCode::PUSHI:
+			stack.push_back(bc.b);
+			break;
+		case OpCode::PUSHL:
+			stack.push_back(locals[bc.a]);
+			break;
+		case OpCode::PUSHLL:
+			stack.push_back(locals[bc.a]);
+			stack.push_back(locals[bc.c]);
+			break;
+		case OpCode::POPL:
+			locals[bc.a] = pop();
+			break;
+		case OpCode::POP:
+			pop();
+			break;
+		case OpCode::INCL:
+			locals[bc.a] = Evaluate(OpCode::ADD, locals[bc.a], bc.b);
+			break;
+		case OpCode::MOVL:
+			locals[bc.a] = locals[bc.c];
+			break;
+		case OpCode::MOVI:
+			locals[bc.a] = bc.b;
+			break;
+		case OpCode::NEG:
+			stack.back() = Evaluate(OpCode::SUB, 0LL, stack.back());
+			break;
+		case OpCode::NOT:
+			stack.back() = !stack.back();
+			break;
+		case OpCode::ADDI:
+		case OpCode::SUBI:
+		case OpCode::MULI:
+		case OpCode::DIVI:
+		case OpCode::MODI:
+			stack.back() = Evaluate(immOps[static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::ADDI)], stack.back(), bc.b);
+			break;
+		case OpCode::SHLI:
+		case OpCode::SHRI:
+		case OpCode::MASKI:
+			stack.back() = Evaluate(bc.op, stack.back(), bc.b);
+			break;
+		case OpCode::JMP:
+			next = bc.a;
+			break;
+		case OpCode::JZ:
+			branch = true;
+			taken = pop() == 0LL;
+			break;
+		case OpCode::JZEQLI:
+		case OpCode::JZNELI:
+		case OpCode::JZGTLI:
+		case OpCode::JZLTLI:
+		case OpCode::JZGELI:
+		case OpCode::JZLELI: {
+			branch = true;
+			auto cmp = static_cast<OpCode>(static_cast<size_t>(OpCode::CMPEQ) +
+				static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::JZEQLI));
+			taken = Evaluate(cmp, locals[bc.c], bc.b) == 0LL;
+			break;
+		}
+		default:
+			if (!IsBinary(bc.op)) {
+				// calls, returns and exits
+				return false;
+			}
+			{
+				var right = pop();
+				var left = pop();
+				if ((bc.op == OpCode::DIV || bc.op == OpCode::MOD) && (right == 0LL || IsOverflow(left, right))) {
+					return false;
+				}
+				stack.push_back(Evaluate(bc.op, left, right));
+			}
+			break;
+		}
+		if (branch && taken) {
+			next = bc.a;
+		}
+		steps_.push_back({ ip, taken });
+		maxDepth_ = std::max(maxDepth_, stack.size());
+		// a side exit continues on the frame with empty stack
+		if (branch && !stack.empty()) {
+			return false;
+		}
+		if (next == head) {
+			return stack.empty();
+		}
+		if (next <= ip) {
+			return false;
+		}
+		ip = next;
+	}
+	return false;
+}
+
+void TraceJit::LoadTemp(int reg, size_t depth) {
+	if (depth >= std::size(tempRegs)) {
+		Mem({ 0x8B }, reg, RSP, Slot(static_cast<uint32_t>(depth - std::size(tempRegs))));
+	} else if (tempRegs[depth] != reg) {
+		Reg({ 0x89 }, tempRegs[depth], reg);
+	}
+}
+
+void TraceJit::StoreTemp(size_t depth, int reg) {
+	if (depth >= std::size(tempRegs)) {
+		Mem({ 0x89 }, reg, RSP, Slot(static_cast<uint32_t>(depth - std::size(tempRegs))));
+	} else if (tempRegs[depth] != reg) {
+		Reg({ 0x89 }, reg, tempRegs[depth]);
+	}
+}
+
+void TraceJit::Load(int reg, const Value& value) {
+	switch (value.kind) {
+	case Value::IMM:
+		MovImm(reg, value.imm);
+		break;
+	case Value::LOCAL:
+		if (homes_[value.slot] < 0) {
+			Mem({ 0x8B }, reg, BP, Slot(value.slot));
+		} else if (homes_[value.slot] != reg) {
+			Reg({ 0x89 }, homes_[value.slot], reg);
+		}
+		break;
+	case Value::TEMP:
+		LoadTemp(reg, value.slot);
+		break;
+	}
+}
+
+void TraceJit::Materialize(size_t depth) {
+	auto& value = stack_[depth];
+	if (value.kind != Value::TEMP) {
+		Load(RAX, value);
+		StoreTemp(depth, RAX);
+		value = { Value::TEMP, 0LL, static_cast<uint32_t>(depth) };
+	}
+}
+
+void TraceJit::Alias(uint32_t slot) {
+	for (size_t d = 0; d < stack_.size(); d++) {
+		if (stack_[d].kind == Value::LOCAL && stack_[d].slot == slot) {
+			Materialize(d);
+		}
+	}
+}
+
+void TraceJit::Assign(uint32_t slot, const Value& value) {
+	Alias(slot);
+	int home = homes_[slot];
+	if (home >= 0) {
+		Load(home, value);
+		dirty_[slot] = true;
+	} else if (value.kind == Value::IMM && IsInt32(value.imm)) {
+		// mov qword [rdi + slot], imm32
+		Mem({ 0xC7 }, 0, BP, Slot(slot));
+		Int32(static_cast<int32_t>(value.imm));
+	} else {
+		Load(RAX, value);
+		Mem({ 0x89 }, RAX, BP, Slot(slot));
+	}
+	known_[slot] = value.kind == Value::IMM;
+	constants_[slot] = value.imm;
+}
+
+void TraceJit::Guard(uint8_t cc, uint64_t ip, Exit exit) {
+	Jump({ 0x0F, static_cast<uint8_t>(0x80 + cc) }, exits_.size(), guards_);
+	exits_.push_back({ ip, exit });
+}
+
+void TraceJit::Binary(OpCode op, uint64_t ip) {
+	Value right = stack_.back();
+	stack_.pop_back();
+	Value left = stack_.back();
+	stack_.pop_back();
+	bool divide = op == OpCode::DIV || op == OpCode::MOD;
+	if (left.kind == Value::IMM && right.kind == Value::IMM && !(divide && (right.imm == 0LL || IsOverflow(left.imm, right.imm)))) {
+		stack_.push_back({ Value::IMM, Evaluate(op, left.imm, right.imm), 0 });
+		return;
+	}
+	size_t depth = stack_.size();
+	Load(RAX, left);
+	if (divide && right.kind == Value::IMM && Divide(op, right.imm)) {
+		StoreTemp(depth, RAX);
+		stack_.push_back({ Value::TEMP, 0LL, static_cast<uint32_t>(depth) });
+		return;
+	}
+	Load(RCX, right);
+	if (divide && (right.kind != Value::IMM || right.imm == 0LL)) {
+		// test rcx, rcx; je exit
+		Reg({ 0x85 }, RCX, RCX);
+		Guard(CC_E, ip, Exit::DIVIDED_BY_ZERO);
+	}
+	if (divide && (right.kind != Value::IMM || right.imm == -1LL) &&
+		(left.kind != Value::IMM || left.imm == LLONG_MIN)) {
+		// cmp rcx, -1; jne ok; mov rdx, rax; neg rdx; jo exit, only the least rax overflows
+		Reg({ 0x83 }, 7, RCX);
+		Byte(0xFF);
+		Byte(0x70 + CC_NE);
+		Byte(3 + 3 + 6);
+		Reg({ 0x89 }, RAX, RDX);
+		Reg({ 0xF7 }, 3, RDX);
+		Guard(CC_O, ip, Exit::OVERFLOW);
+	}
+	Operate(op);
+	StoreTemp(depth, RAX);
+	stack_.push_back({ Value::TEMP, 0LL, static_cast<uint32_t>(depth) });
+}
+
+void TraceJit::Compare(size_t idx, const Value& left, const Value& right, const Step& step, uint64_t target) {
+	if (left.kind == Value::IMM && right.kind == Value::IMM) {
+		// the direction is known, as recorded
+		return;
+	}
+	Load(RAX, left);
+	if (right.kind == Value::IMM && IsInt32(right.imm)) {
+		// cmp rax, imm32
+		Reg({ 0x81 }, 7, RAX);
+		Int32(static_cast<int32_t>(right.imm));
+	} else {
+		Load(RCX, right);
+		Reg({ 0x39 }, RCX, RAX);
+	}
+	// leave where the comparison goes the other way
+	if (step.taken) {
+		Guard(conditions[idx], step.ip + 1, Exit::GUARD);
+	} else {
+		Guard(inverses[idx], target, Exit::GUARD);
+	}
+}
+
+bool TraceJit::Compile(const Program& program, const FuncInfo& func, Trace& trace) {
+	const auto& code = program.code;
+	uint32_t slots = func.argc + func.varc;
+	buf_.clear();
+	stack_.clear();
+	exits_.clear();
+	guards_.clear();
+
+	// the most used locals get registers
+	std::vector<uint64_t> uses(slots, 0);
+	for (const auto& step : steps_) {
+		const auto& bc = code[step.ip];
+		switch (bc.op) {
+		case OpCode::PUSHL:
+		case OpCode::POPL:
+		case OpCode::INCL:
+		case OpCode::MOVI:
+			uses[bc.a]++;
+			break;
+		case OpCode::PUSHLL:
+		case OpCode::MOVL:
+			uses[bc.a]++;
+			uses[bc.c]++;
+			break;
+		default:
+			if (bc.op >= OpCode::JZEQLI && bc.op <= OpCode::JZLELI) {
+				uses[bc.c]++;
+			}
+			break;
+		}
+	}
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < slots; i++) {
+		if (uses[i] > 0) {
+			order.push_back(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&uses](uint32_t l, uint32_t r) {
+		return uses[l] > uses[r];
+	});
+	homes_.assign(slots, -1);
+	dirty_.assign(slots, false);
+	known_.assign(slots, false);
+	constants_.assign(slots, 0LL);
+	std::vector<int> saved;
+	for (size_t i = 0; i < order.size() && i < std::size(localRegs); i++) {
+		homes_[order[i]] = localRegs[i];
+		if (IsCalleeSaved(localRegs[i])) {
+			saved.push_back(localRegs[i]);
+		}
+	}
+
+	for (int reg : saved) {
+		Push(reg);
+	}
+	// sub rsp, spilled temps
+	int32_t spilled = maxDepth_ > std::size(tempRegs) ? Slot(static_cast<uint32_t>(maxDepth_ - std::size(tempRegs))) : 0;
+	if (spilled > 0) {
+		Reg({ 0x81 }, 5, RSP);
+		Int32(spilled);
+	}
+	for (uint32_t i = 0; i < slots; i++) {
+		if (homes_[i] >= 0) {
+			Mem({ 0x8B }, homes_[i], BP, Slot(i));
+		}
+	}
+	size_t loop = buf_.size();
+
+	auto local = [this](uint32_t slot) -> Value {
+		if (known_[slot]) {
+			return { Value::IMM, constants_[slot], 0 };
+		}
+		return { Value::LOCAL, 0LL, slot };
+	};
+	auto pop = [this]() {
+		Value value = stack_.back();
+		stack_.pop_back();
+		return value;
+	};
+
+	for (size_t i = 0; i < steps_.size(); i++) {
+		const auto& step = steps_[i];
+		const auto& bc = code[step.ip];
+		switch (bc.op) {
+		case OpCode::PUSHI:
+			stack_.push_back({ Value::IMM, bc.b, 0 });
+			break;
+		case OpCode::PUSHL:
+			stack_.push_back(local(bc.a));
+			break;
+		case OpCode::PUSHLL:
+			stack_.push_back(local(bc.a));
+			stack_.push_back(local(bc.c));
+			break;
+		case OpCode::POPL:
+			Assign(bc.a, pop());
+			break;
+		case OpCode::POP:
+			pop();
+			break;
+		case OpCode::MOVL:
+			Assign(bc.a, local(bc.c));
+			break;
+		case OpCode::MOVI:
+			Assign(bc.a, { Value::IMM, bc.b, 0 });
+			break;
+		case OpCode::INCL:
+			if (known_[bc.a] || !IsInt32(bc.b)) {
+				stack_.push_back(local(bc.a));
+				stack_.push_back({ Value::IMM, bc.b, 0 });
+				Binary(OpCode::ADD, step.ip);
+				Assign(bc.a, pop());
+			} else {
+				Alias(bc.a);
+				// add qword reg|[rdi + slot], imm32
+				if (homes_[bc.a] >= 0) {
+					Reg({ 0x81 }, 0, homes_[bc.a]);
+					dirty_[bc.a] = true;
+				} else {
+					Mem({ 0x81 }, 0, BP, Slot(bc.a));
+				}
+				Int32(static_cast<int32_t>(bc.b));
+			}
+			break;
+		case OpCode::NEG:
+		case OpCode::NOT: {
+			Value value = pop();
+			size_t depth = stack_.size();
+			if (value.kind == Value::IMM) {
+				stack_.push_back({ Value::IMM, bc.op == OpCode::NEG ? Evaluate(OpCode::SUB, 0LL, value.imm) : !value.imm, 0 });
+				break;
+			}
+			Load(RAX, value);
+			if (bc.op == OpCode::NEG) {
+				Reg({ 0xF7 }, 3, RAX);
+			} else {
+				// test rax, rax; sete al; movzx eax, al
+				Reg({ 0x85 }, RAX, RAX);
+				Byte(0x0F);
+				Byte(0x90 + CC_E);
+				Byte(0xC0);
+				Byte(0x0F);
+				Byte(0xB6);
+				Byte(0xC0);
+			}
+			StoreTemp(depth, RAX);
+			stack_.push_back({ Value::TEMP, 0LL, static_cast<uint32_t>(depth) });
+			break;
+		}
+		case OpCode::ADDI:
+		case OpCode::SUBI:
+		case OpCode::MULI:
+		case OpCode::DIVI:
+		case OpCode::MODI:
+			stack_.push_back({ Value::IMM, bc.b, 0 });
+			Binary(immOps[static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::ADDI)], step.ip);
+			break;
+		case OpCode::SHLI:
+		case OpCode::SHRI:
+		case OpCode::MASKI: {
+			Value value = pop();
+			size_t depth = stack_.size();
+			if (value.kind == Value::IMM) {
+				stack_.push_back({ Value::IMM, Evaluate(bc.op, value.imm, bc.b), 0 });
+				break;
+			}
+			Load(RAX, value);
+			Shift(bc.op, bc.b);
+			StoreTemp(depth, RAX);
+			stack_.push_back({ Value::TEMP, 0LL, static_cast<uint32_t>(depth) });
+			break;
+		}
+		case OpCode::JMP:
+			// the trace is linear
+			break;
+		case OpCode::JZ: {
+			Value cond = pop();
+			if (cond.kind != Value::IMM) {
+				Load(RAX, cond);
+				Reg({ 0x85 }, RAX, RAX);
+				if (step.taken) {
+					Guard(CC_NE, step.ip + 1, Exit::GUARD);
+				} else {
+					Guard(CC_E, bc.a, Exit::GUARD);
+				}
+			}
+			break;
+		}
+		case OpCode::JZEQLI:
+		case OpCode::JZNELI:
+		case OpCode::JZGTLI:
+		case OpCode::JZLTLI:
+		case OpCode::JZGELI:
+		case OpCode::JZLELI:
+			Compare(static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::JZEQLI),
+				local(bc.c), { Value::IMM, bc.b, 0 }, step, bc.a);
+			break;
+		default:
+			if (IsCompare(bc.op) && i + 1 < steps_.size() && code[steps_[i + 1].ip].op == OpCode::JZ) {
+				// cmp; jz is a compare and a conditional jump
+				Value right = pop();
+				Value left = pop();
+				const auto& jz = steps_[++i];
+				Compare(static_cast<size_t>(bc.op) - static_cast<size_t>(OpCode::CMPEQ), left, right, jz, code[jz.ip].a);
+				break;
+			}
+			Binary(bc.op, step.ip);
+			break;
+		}
+	}
+	// jmp loop
+	Byte(0xE9);
+	Int32(static_cast<int32_t>(loop - (buf_.size() + 4)));
+
+	// side exits write the locals in registers back to the frame, rax is what to continue
+	std::vector<size_t> stubs;
+	std::vector<size_t> leaves;
+	for (const auto& exit : exits_) {
+		stubs.push_back(buf_.size());
+		for (uint32_t i = 0; i < slots; i++) {
+			if (dirty_[i]) {
+				Mem({ 0x89 }, homes_[i], BP, Slot(i));
+			}
+		}
+		// a failed div or mod is -(2 * ip + overflow) - 1
+		var next = static_cast<var>(exit.first);
+		MovImm(RAX, exit.second == Exit::GUARD ? next : -(2 * next + (exit.second == Exit::OVERFLOW)) - 1);
+		Byte(0xE9);
+		leaves.push_back(buf_.size());
+		Int32(0);
+	}
+	size_t epilogue = buf_.size();
+	if (spilled > 0) {
+		Reg({ 0x81 }, 0, RSP);
+		Int32(spilled);
+	}
+	for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+		Pop(*it);
+	}
+	Byte(0xC3);
+
+	for (const auto& it : guards_) {
+		Patch(it.first, stubs[it.second]);
+	}
+	for (size_t at : leaves) {
+		Patch(at, epilogue);
+	}
+	trace.code = Install(trace.size);
+	trace.length = steps_.size();
+	return trace.code != nullptr;
+}
+
+bool TraceJit::Run(uint64_t head, var* bp, uint64_t& ip, bool& overflow) const {
+	auto entry = reinterpret_cast<int64_t (*)(var*)>(traces_[head].code);
+	int64_t next = entry(bp);
+	if (next < 0) {
+		auto failed = static_cast<uint64_t>(-(next + 1));
+		ip = failed >> 1;
+		overflow = (failed & 1) != 0;
+		return false;
+	}
+	ip = static_cast<uint64_t>(next);
+	return true;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file tracejit.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief
+ * @version 0.1
+ * @date 2025-04-10
+ *
+ * @copyright huyong Copyright (c) 2025
+ *
+ */
+
+#ifndef TRACEJIT_H
+#define TRACEJIT_H
+
+#include "emitter.h"
+#include "instruction.h"
+
+// longest trace in instructions, a longer iteration is left to the interpreter
+constexpr size_t MAX_TRACE_LENGTH = 1024;
+// recordings of a loop, e.g. an iteration leaving the loop is recorded again next time
+constexpr uint32_t MAX_TRACE_ATTEMPTS = 4;
+
+// Tracing JIT of hot loops: an iteration of a loop is recorded on the running frame,
+// from its head back to it through the directions its branches actually take.
+// The linear trace is compiled with those branches as guards, so constants are folded
+// and the most used locals stay in registers across the blocks of the iteration.
+// The machine code loops until a guard fails, then the interpreter continues
+// at the direction which is not recorded.
+// A trace has no calls and no inner loops, which get traces of their own.
+class TraceJit : private Emitter {
+public:
+    TraceJit() = default;
+    TraceJit(const TraceJit&) = delete;
+    TraceJit& operator=(const TraceJit&) = delete;
+    ~TraceJit();
+
+    // forget the traces of the last program
+    void Reset(const Program& program);
+
+    enum class State {
+        UNTRIED,
+        READY,
+        FAILED
+    };
+
+    inline State GetState(uint64_t head) const {
+        return states_[head];
+    }
+
+    // instructions of the trace at head
+    inline size_t GetLength(uint64_t head) const {
+        return traces_[head].length;
+    }
+
+    // Records an iteration of the loop at head from the locals of the frame at bp,
+    // depth is the stack of frame which must be empty, then compiles the trace.
+    bool Record(const Program& program, uint64_t head, uint32_t funcIdx, uint64_t depth, const var* bp);
+
+    // runs the trace of head on the frame at bp, ip is where the interpreter continues.
+    // false if div or mod at ip fails, overflow tells whether it overflows or is divided by zero
+    bool Run(uint64_t head, var* bp, uint64_t& ip, bool& overflow) const;
+
+private:
+    // an instruction of the trace, and whether its branch jumps
+    struct Step {
+        uint64_t ip;
+        bool taken;
+    };
+
+    // operand of symbolic stack, a temp of depth d is in slot
+    struct Value {
+        enum Kind {
+            IMM,
+            LOCAL,
+            TEMP
+        } kind;
+        var imm;
+        uint32_t slot;
+    };
+
+    // why a side exit leaves the trace, the interpreter fails at the exit of a div or mod
+    enum class Exit : uint8_t {
+        GUARD,
+        DIVIDED_BY_ZERO,
+        OVERFLOW
+    };
+
+    struct Trace {
+        void* code;
+        size_t size;
+        size_t length;
+    };
+
+    bool Simulate(const Program& program, uint64_t head, const FuncInfo& func, const var* bp);
+    bool Compile(const Program& program, const FuncInfo& func, Trace& trace);
+
+    void Load(int reg, const Value& value);
+    // put operand at depth into its temp register
+    void Materialize(size_t depth);
+    // operands which read the local are materialized before it is written
+    void Alias(uint32_t slot);
+    void Assign(uint32_t slot, const Value& value);
+    void Binary(OpCode op, uint64_t ip);
+    // compare of a fused cmp; jz, or jzxxli, idx is of cmpeq ~ cmple
+    void Compare(size_t idx, const Value& left, const Value& right, const Step& step, uint64_t target);
+    void Guard(uint8_t cc, uint64_t ip, Exit exit);
+    // temps of deep stack are spilled to the native stack
+    void LoadTemp(int reg, size_t depth);
+    void StoreTemp(size_t depth, int reg);
+
+    std::vector<State> states_;
+    std::vector<uint32_t> attempts_;
+    std::vector<Trace> traces_;
+
+    // states of the trace being compiled
+    std::vector<Step> steps_;
+    size_t maxDepth_{ 0 };
+    std::vector<Value> stack_;
+    // register of each slot, or -1 in frame
+    std::vector<int> homes_;
+    std::vector<bool> dirty_;
+    // slots of known constants in this iteration
+    std::vector<bool> known_;
+    std::vector<var> constants_;
+    // side exits: ip to continue, and why
+    std::vector<std::pair<uint64_t, Exit>> exits_;
+    std::vector<std::pair<size_t, uint64_t>> guards_;
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file tracer.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief 
+ * @version 0.1
+ * @date 2025-04-10
+ * 
+ * @copyright huyong Copyright (c) 2025
+ * 
+ */
+
+#include "tracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+bool GetTraceLevel(const std::string& str, TraceLevel& level) {
+    static const std::map<std::string, TraceLevel> levels = {
+        { "off", TraceLevel::OFF },
+        { "calls", TraceLevel::CALLS },
+        { "insts", TraceLevel::INSTS },
+        { "full", TraceLevel::FULL }
+    };
+    auto it = levels.find(str);
+    if (it == levels.end()) {
+        return false;
+    }
+    level = it->second;
+    return true;
+}
+
+void Tracer::Call(const Program& program, uint64_t ip, uint32_t callee, uint64_t depth) {
+    Indent(depth);
+    Append("[call]: ");
+    Append(program.funcs[callee].name);
+    Append(" at ");
+    Append(ip);
+    EndLine();
+}
+
+void Tracer::Ret(const Program& program, uint64_t ip, uint32_t callee, var value, uint64_t depth) {
+    Indent(depth);
+    Append("[ret]: ");
+    Append(program.funcs[callee].name);
+    Append(" ");
+    Append(value);
+    Append(" to ");
+    Append(ip);
+    EndLine();
+}
+
+void Tracer::Inst(const Program& program, uint64_t ip) {
+    const auto& bc = program.code[ip];
+    auto it = program.labels.find(ip);
+    Append("[run]: ");
+    Append(ip);
+    Append("\t");
+    Append(it == program.labels.end() ? "" : it->second.c_str());
+    Append("\t");
+    Append(opCodeInfos[static_cast<size_t>(bc.op)].str);
+    Append("\t");
+    Append(static_cast<uint64_t>(bc.a));
+    Append("\t");
+    Append(bc.b);
+    Append("\t");
+    Append(static_cast<uint64_t>(bc.c));
+    EndLine();
+}
+
+void Tracer::State(const Cpu& cpu) {
+    std::ostringstream oss;
+    cpu.Print(oss);
+    Append(oss.str());
+    EndLine();
+}
+
+void Tracer::Message(const std::string& msg) {
+    Append(msg);
+    EndLine();
+}
+
+void Tracer::Flush() {
+    if (buffer_.empty()) {
+        return;
+    }
+    out_.write(buffer_.data(), buffer_.size());
+    out_.flush();
+    buffer_.clear();
+}
+
+void Tracer::Stats(size_t top) {
+    std::vector<std::tuple<uint64_t, OpCode, OpCode>> pairs;
+    uint64_t total = 0;
+    for (size_t i = 0; i < pairs_.size(); i++) {
+        for (size_t j = 0; j < pairs_[i].size(); j++) {
+            if (pairs_[i][j] > 0) {
+                pairs.push_back({ pairs_[i][j], static_cast<OpCode>(i), static_cast<OpCode>(j) });
+                total += pairs_[i][j];
+            }
+        }
+    }
+    if (total == 0) {
+        // nothing is run by the stack code
+        return;
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const auto& l, const auto& r) {
+        return std::get<0>(l) > std::get<0>(r);
+    });
+
+    Append("[stats]: dispatches ");
+    Append(total);
+    EndLine();
+    for (size_t i = 0; i < pairs.size() && i < top; i++) {
+        Append("\t");
+        Append(opCodeInfos[static_cast<size_t>(std::get<1>(pairs[i]))].str);
+        Append(" -> ");
+        Append(opCodeInfos[static_cast<size_t>(std::get<2>(pairs[i]))].str);
+        Append("\t");
+        Append(std::get<0>(pairs[i]));
+        EndLine();
+    }
+    Flush();
+}
+
+bool Tracer::Profile(const Program& program, const std::string& path) const {
+    // jumps to an IR use the last of its labels, as the optimizer merges them.
+    // A jump of the fuser counts for the jz it comes from, an inverted one the other way
+    std::map<std::string, BranchCount> counts;
+    for (const auto& it : branches_) {
+        uint64_t target = program.code[it.first].a;
+        bool inverted = false;
+        auto source = program.sources.find(it.first);
+        if (source != program.sources.end()) {
+            target = source->second.first;
+            inverted = source->second.second;
+        }
+        auto label = program.labels.find(target);
+        if (label == program.labels.end()) {
+            continue;
+        }
+        auto& count = counts[label->second.substr(label->second.rfind(',') + 1)];
+        count.taken += inverted ? it.second.fallen : it.second.taken;
+        count.fallen += inverted ? it.second.taken : it.second.fallen;
+    }
+
+    std::ofstream file{ path };
+    if (!file) {
+        std::cerr << "[err]: Write profile " << path << " failed!" << std::endl;
+        return false;
+    }
+    file << "# label jumped to, taken, fallen" << std::endl;
+    for (const auto& it : counts) {
+        file << it.first << " " << it.second.taken << " " << it.second.fallen << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file tracer.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief 
+ * @version 0.1
+ * @date 2025-04-10
+ * 
+ * @copyright huyong Copyright (c) 2025
+ * 
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <array>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "instruction.h"
+
+enum class TraceLevel : int {
+    OFF = 0,
+    CALLS,  // call and ret
+    INSTS,  // every instruction
+    FULL    // every instruction and the cpu state after it
+};
+
+bool GetTraceLevel(const std::string& str, TraceLevel& level);
+
+// Trace lines are collected in a buffer and written to the sink in blocks.
+class Tracer {
+public:
+    explicit Tracer(std::ostream& out, TraceLevel level = TraceLevel::OFF,
+        size_t bufferSize = DEFAULT_BUFFER_SIZE) : out_{ out }, level_{ level }, bufferSize_{ bufferSize } {
+        buffer_.reserve(bufferSize_);
+    }
+    ~Tracer() {
+        Flush();
+    }
+
+    inline TraceLevel GetLevel() const {
+        return level_;
+    }
+
+    inline bool IsOn(TraceLevel level) const {
+        return level_ >= level;
+    }
+
+    // count dynamic opcode pairs, for choosing superinstructions
+    inline void SetStats(bool stats) {
+        stats_ = stats;
+    }
+
+    inline bool IsStats() const {
+        return stats_;
+    }
+
+    // count taken and fallen jz of each ip, for a profile which lays out blocks
+    inline void SetProfile(bool profile) {
+        profile_ = profile;
+    }
+
+    inline bool IsProfile() const {
+        return profile_;
+    }
+
+    inline bool IsActive() const {
+        return level_ != TraceLevel::OFF || stats_ || profile_;
+    }
+
+    inline void Count(OpCode op) {
+        ++pairs_[static_cast<size_t>(prev_)][static_cast<size_t>(op)];
+        prev_ = op;
+    }
+
+    inline void Branch(uint64_t ip, bool taken) {
+        auto& count = branches_[ip];
+        ++(taken ? count.taken : count.fallen);
+    }
+
+    // print the top pairs of opcodes
+    void Stats(size_t top = DEFAULT_STATS_TOP);
+    // write the counts of jz by the labels they jump to, as Assembler::LoadProfile reads
+    bool Profile(const Program& program, const std::string& path) const;
+
+    void Call(const Program& program, uint64_t ip, uint32_t callee, uint64_t depth);
+    void Ret(const Program& program, uint64_t ip, uint32_t callee, var value, uint64_t depth);
+    void Inst(const Program& program, uint64_t ip);
+    void State(const Cpu& cpu);
+    void Message(const std::string& msg);
+    void Flush();
+
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 1ULL << 16;
+    static constexpr size_t DEFAULT_STATS_TOP = 20;
+
+private:
+    inline void Append(const std::string& str) {
+        buffer_ += str;
+    }
+    inline void Append(const char* str) {
+        buffer_ += str;
+    }
+    inline void Append(uint64_t value) {
+        buffer_ += std::to_string(value);
+    }
+    inline void Append(var value) {
+        buffer_ += std::to_string(value);
+    }
+    inline void Indent(uint64_t depth) {
+        buffer_.append(depth * 2, ' ');
+    }
+    inline void EndLine() {
+        buffer_ += '\n';
+        if (buffer_.size() >= bufferSize_) {
+            Flush();
+        }
+    }
+
+    std::ostream& out_;
+    TraceLevel level_;
+    size_t bufferSize_;
+    std::string buffer_;
+
+    bool stats_{ false };
+    OpCode prev_{ OpCode::NIL };
+    std::array<std::array<uint64_t, static_cast<size_t>(OpCode::MAX)>, static_cast<size_t>(OpCode::MAX)> pairs_{};
+
+    bool profile_{ false };
+    std::unordered_map<uint64_t, BranchCount> branches_;
+};
+
+#endif
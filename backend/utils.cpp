@@ -70,4 +70,14 @@ void Split(const std::string& str, const std::string& delimiter,
     tokens.emplace_back(Trim(str.substr(start)));
 }
 
+bool ParseInteger(const std::string& str, long long& value) {
+    try {
+        size_t pos = 0;
+        value = std::stoll(str, &pos);
+        return pos == str.size();
+    } catch (const std::exception& ex) {
+        return false;
+    }
+}
+
 } // namespace Utils
\ No newline at end of file
@@ -31,6 +31,9 @@ bool Partition(const std::string& str, const std::string& delimiter,
 void Split(const std::string& str, const std::string& delimiter, 
     std::vector<std::string>& tokens);
 
+// the whole string is a decimal integer
+bool ParseInteger(const std::string& str, long long& value);
+
 } // namespace Utils
 
 #endif
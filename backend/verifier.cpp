@@ -0,0 +1,256 @@
+/**
+ * @file verifier.cpp
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief 
+ * @version 0.1
+ * @date 2025-04-10
+ * 
+ * @copyright huyong Copyright (c) 2025
+ * 
+ */
+
+#include "verifier.h"
+
+#include <algorithm>
+#include <iostream>
+
+bool Verifier::Verify(Program& program) {
+    program.verified = false;
+    if (program.code.empty() || program.code.back().op != OpCode::HALT || program.funcs.empty()) {
+        std::cerr << "[verify]: Code is not end with halt." << std::endl;
+        return false;
+    }
+    for (const auto& it : program.code) {
+        if (it.op <= OpCode::NIL || it.op >= OpCode::MAX) {
+            std::cerr << "[verify]: Unknown opcode." << std::endl;
+            return false;
+        }
+    }
+
+    for (uint32_t f = 0; f < program.funcs.size(); f++) {
+        if (!VerifyFunc(program, f)) {
+            return false;
+        }
+    }
+
+    program.verified = true;
+    return true;
+}
+
+bool Verifier::Error(const Program& program, uint32_t funcIdx, uint64_t ip, const char* msg) {
+    std::cerr << "[verify]: " << (funcIdx == 0 ? "<top>" : program.funcs[funcIdx].name) <<
+        " at " << ip << ": " << msg << std::endl;
+    return false;
+}
+
+// the state of a target is the meet of all incoming states:
+// depth must be the same, and assigned slots are intersected
+bool Verifier::Merge(const Program& program, uint32_t funcIdx, uint64_t from, uint64_t to, const State& state) {
+    const auto& func = program.funcs[funcIdx];
+    if (to == program.code.size() - 1) {
+        // halt ends the program at any depth
+        return true;
+    }
+    if (to < func.entry || to >= func.end) {
+        return Error(program, funcIdx, from, "flow leaves the function.");
+    }
+
+    auto& target = states_[to - func.entry];
+    if (!target.visited) {
+        target = state;
+        worklist_.push_back(to);
+        return true;
+    }
+    if (target.depth != state.depth) {
+        return Error(program, funcIdx, to, "stack depth mismatches between paths.");
+    }
+    bool changed = false;
+    for (size_t i = 0; i < target.assigned.size(); i++) {
+        if (target.assigned[i] && !state.assigned[i]) {
+            target.assigned[i] = false;
+            changed = true;
+        }
+    }
+    if (changed) {
+        worklist_.push_back(to);
+    }
+    return true;
+}
+
+bool Verifier::VerifyFunc(Program& program, uint32_t funcIdx) {
+    auto& func = program.funcs[funcIdx];
+    uint32_t slotSize = func.argc + func.varc;
+    if (func.entry > func.end || func.end >= program.code.size()) {
+        return Error(program, funcIdx, func.entry, "wrong range of function.");
+    }
+
+    states_.assign(func.end - func.entry, State{});
+    worklist_.clear();
+    if (func.entry == func.end) {
+        return true;
+    }
+
+    State entry;
+    entry.visited = true;
+    entry.assigned.assign(slotSize, false);
+    std::fill(entry.assigned.begin(), entry.assigned.begin() + func.argc, true);
+    states_[0] = entry;
+    worklist_.push_back(func.entry);
+
+    int64_t maxDepth = 0;
+    while (!worklist_.empty()) {
+        uint64_t ip = worklist_.back();
+        worklist_.pop_back();
+        State state = states_[ip - func.entry];
+        const auto& bc = program.code[ip];
+        // assigned slots only shrink while the states settle, so a read seen unassigned stays so
+        auto unassigned = [&state](uint32_t slot) {
+            return !state.assigned[slot];
+        };
+
+        // pops and pushes of the instruction
+        int64_t pops = 0;
+        int64_t pushes = 0;
+        bool fallThrough = true;
+        switch (bc.op) {
+        case OpCode::NEG:
+        case OpCode::NOT:
+            pops = 1;
+            pushes = 1;
+            break;
+        case OpCode::PUSHI:
+            pushes = 1;
+            break;
+        case OpCode::PUSHL:
+            if (bc.a >= slotSize) {
+                return Error(program, funcIdx, ip, "undefined variable.");
+            }
+            if (unassigned(bc.a)) {
+                return Error(program, funcIdx, ip, "variable may be unassigned.");
+            }
+            pushes = 1;
+            break;
+        case OpCode::POPL:
+            if (bc.a >= slotSize) {
+                return Error(program, funcIdx, ip, "undefined variable.");
+            }
+            pops = 1;
+            break;
+        case OpCode::POP:
+            pops = 1;
+            break;
+        case OpCode::JMP:
+            fallThrough = false;
+            break;
+        case OpCode::JZ:
+            pops = 1;
+            break;
+        case OpCode::CALL:
+            if (bc.a == 0 || bc.a >= program.funcs.size()) {
+                return Error(program, funcIdx, ip, "undefined function.");
+            }
+            pops = program.funcs[bc.a].argc;
+            pushes = 1;
+            break;
+        case OpCode::TAILCALL:
+            // the frame of top level code is not a callee's, nothing returns from it
+            if (bc.a == 0 || bc.a >= program.funcs.size() || funcIdx == 0) {
+                return Error(program, funcIdx, ip, "wrong tail call.");
+            }
+            pops = program.funcs[bc.a].argc;
+            fallThrough = false;
+            break;
+        case OpCode::RET:
+            if (state.depth != 1) {
+                return Error(program, funcIdx, ip, "stack is not balanced at ret.");
+            }
+            fallThrough = false;
+            break;
+        case OpCode::RETV:
+            if (state.depth != 0) {
+                return Error(program, funcIdx, ip, "stack is not balanced at ret.");
+            }
+            fallThrough = false;
+            break;
+        case OpCode::EXIT:
+            pops = 1;
+            fallThrough = false;
+            break;
+        case OpCode::EXITV:
+        case OpCode::HALT:
+            fallThrough = false;
+            break;
+        case OpCode::INCL:
+        case OpCode::MOVI:
+            if (bc.a >= slotSize) {
+                return Error(program, funcIdx, ip, "undefined variable.");
+            }
+            if (bc.op == OpCode::INCL && unassigned(bc.a)) {
+                return Error(program, funcIdx, ip, "variable may be unassigned.");
+            }
+            break;
+        case OpCode::MOVL:
+        case OpCode::PUSHLL:
+            if (bc.a >= slotSize || bc.c >= slotSize) {
+                return Error(program, funcIdx, ip, "undefined variable.");
+            }
+            // movl reads c only
+            if ((bc.op == OpCode::PUSHLL && unassigned(bc.a)) || unassigned(bc.c)) {
+                return Error(program, funcIdx, ip, "variable may be unassigned.");
+            }
+            pushes = bc.op == OpCode::PUSHLL ? 2 : 0;
+            break;
+        case OpCode::ADDI:
+        case OpCode::SUBI:
+        case OpCode::MULI:
+        case OpCode::DIVI:
+        case OpCode::MODI:
+        case OpCode::SHLI:
+        case OpCode::SHRI:
+        case OpCode::MASKI:
+            pops = 1;
+            pushes = 1;
+            break;
+        case OpCode::JZEQLI:
+        case OpCode::JZNELI:
+        case OpCode::JZGTLI:
+        case OpCode::JZLTLI:
+        case OpCode::JZGELI:
+        case OpCode::JZLELI:
+            if (bc.c >= slotSize) {
+                return Error(program, funcIdx, ip, "undefined variable.");
+            }
+            if (unassigned(bc.c)) {
+                return Error(program, funcIdx, ip, "variable may be unassigned.");
+            }
+            break;
+        default:
+            // binary operators
+            pops = 2;
+            pushes = 1;
+            break;
+        }
+
+        if (state.depth < pops) {
+            return Error(program, funcIdx, ip, "stack is not enough.");
+        }
+        state.depth += pushes - pops;
+        maxDepth = std::max(maxDepth, state.depth);
+        if (bc.op == OpCode::POPL || bc.op == OpCode::MOVL || bc.op == OpCode::MOVI) {
+            state.assigned[bc.a] = true;
+        }
+
+        bool jump = bc.op == OpCode::JMP || bc.op == OpCode::JZ ||
+            (bc.op >= OpCode::JZEQLI && bc.op <= OpCode::JZLELI);
+        if (jump &&
+            !Merge(program, funcIdx, ip, bc.a, state)) {
+            return false;
+        }
+        if (fallThrough && !Merge(program, funcIdx, ip, ip + 1, state)) {
+            return false;
+        }
+    }
+
+    func.maxStack = static_cast<uint32_t>(maxDepth);
+    return true;
+}
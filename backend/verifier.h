@@ -0,0 +1,43 @@
+/**
+ * @file verifier.h
+ * @author Hu Yong (huyongcode@outlook.com)
+ * @brief 
+ * @version 0.1
+ * @date 2025-04-10
+ * 
+ * @copyright huyong Copyright (c) 2025
+ * 
+ */
+
+#ifndef VERIFIER_H
+#define VERIFIER_H
+
+#include "instruction.h"
+
+// Proves once at load time what the checked handlers test on every instruction:
+// stack depth of each instruction, valid jump and call targets,
+// locals assigned before read, and balanced stack at ret. A program which may read
+// a local not assigned on some path is not verified, so it runs checked in every mode.
+class Verifier {
+public:
+    // On success, Program::verified is set and FuncInfo::maxStack is filled.
+    bool Verify(Program& program);
+
+private:
+    struct State {
+        bool visited{ false };
+        // depth of operands above locals
+        int64_t depth{ 0 };
+        // definitely assigned slots
+        std::vector<bool> assigned;
+    };
+
+    bool VerifyFunc(Program& program, uint32_t funcIdx);
+    bool Merge(const Program& program, uint32_t funcIdx, uint64_t from, uint64_t to, const State& state);
+    bool Error(const Program& program, uint32_t funcIdx, uint64_t ip, const char* msg);
+
+    std::vector<State> states_;
+    std::vector<uint64_t> worklist_;
+};
+
+#endif
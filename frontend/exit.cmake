@@ -0,0 +1,5 @@
+# runs PROGRAM, and fails unless its exit code is EXPECTED
+execute_process(COMMAND "${PROGRAM}" RESULT_VARIABLE result)
+if (NOT result EQUAL EXPECTED)
+  message(FATAL_ERROR "${PROGRAM} exited with ${result}, ${EXPECTED} is expected")
+endif()
@@ -0,0 +1,72 @@
+/* Runtime of the native programs built with macro.inc: print, readint and the entry. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+int64_t hyc_entry(void);
+
+/* items of %d in fmt, %% is a literal '%' */
+static int64_t count_args(const char *fmt) {
+    int64_t n = 0;
+    const char *p;
+    for (p = fmt; *p; p++) {
+        if (p[0] == '%' && (p[1] == 'd' || p[1] == '%')) {
+            n += (p[1] == 'd');
+            p++;
+        }
+    }
+    return n;
+}
+
+/* args are the stack items, args[0] is the last one pushed. Returns their count to pop. */
+int64_t hyc_print(const char *fmt, const int64_t *args) {
+    int64_t i = count_args(fmt);
+    int64_t n = i;
+    const char *p;
+    for (p = fmt; *p; p++) {
+        if (p[0] == '%' && p[1] == 'd') {
+            printf("%lld", (long long)args[--i]);
+            p++;
+        } else if (p[0] == '%' && p[1] == '%') {
+            putchar('%');
+            p++;
+        } else {
+            putchar(*p);
+        }
+    }
+    putchar('\n');
+    return n;
+}
+
+int64_t hyc_readint(const char *prompt) {
+    long long value;
+    printf("%s", prompt);
+    fflush(stdout);
+    if (scanf("%lld", &value) != 1) {
+        fprintf(stderr, "\n*** Error ***\n\treadint: an integer is expected\n");
+        exit(-1);
+    }
+    return value;
+}
+
+void hyc_div_zero(void) {
+    fflush(stdout);
+    fprintf(stderr, "\n*** Error ***\n\tdivided by zero\n");
+    exit(-1);
+}
+
+void hyc_div_overflow(void) {
+    fflush(stdout);
+    fprintf(stderr, "\n*** Error ***\n\tdivision overflow\n");
+    exit(-1);
+}
+
+void hyc_exit(int64_t code) {
+    exit((int)code);
+}
+
+/* the exit status is the return value of main of the script */
+int main(void) {
+    return (int)hyc_entry();
+}
@@ -2046,14 +2046,14 @@ void write_func_head() {
     out_inc("%%define %s.argc %d", _fn, argc);
     out_inc("\n%%MACRO $%s 0\n"
             "   CALL @%s\n"
-            "   ADD ESP, 4*%s.argc\n"
-            "   PUSH EAX\n"
+            "   ADD RSP, 8*%s.argc\n"
+            "   PUSH RAX\n"
             "%%ENDMACRO",
             _fn, _fn, _fn);
     if (argc) {
         out_inc("\n%%MACRO %s.arg %s.argc", _fn, _fn);
         for (i = 0; i < argc; i++) {
-            out_inc("\t%%define %s [EBP + 8 + 4*%s.argc - 4*%d]",
+            out_inc("\t%%define %s [RBP + 16 + 8*%s.argc - 8*%d]",
                         args[i], _fn, i+1);
         }
         out_inc("%%ENDMACRO");
@@ -2062,10 +2062,10 @@ void write_func_head() {
         out_inc("\n%%define %s.varc %d", _fn, varc);
         out_inc("\n%%MACRO %s.var %s.varc", _fn, _fn);
         for (i = 0; i < varc; i++) {
-            out_inc("\t%%define %s [EBP - 4*%d]",
+            out_inc("\t%%define %s [RBP - 8*%d]",
                         vars[i], i+1);
         }
-        out_inc("\tSUB ESP, 4*%s.varc", _fn);
+        out_inc("\tSUB RSP, 8*%s.varc", _fn);
         out_inc("%%ENDMACRO");
     }
 }
@@ -2075,7 +2075,7 @@ void write_func_tail() {
 
     out_asm("ENDFUNC@%s\n", _fn);
 
-    out_inc("\n%%MACRO ENDFUNC@%s 0\n\tLEAVE\n\tRET", _fn);
+    out_inc("\n%%MACRO ENDFUNC@%s 0\n\tXOR EAX, EAX\n\tLEAVE\n\tRET", _fn);
     for (i = 0; i < argc; i++) {
         out_inc("\t%%undef %s", args[i]);
     }